@@ -311,7 +311,7 @@ namespace mini {
     }
 
     std::cout << "saving to " << outFileName << std::endl;
-    scene->save(outFileName);
+    scene->saveParallel(outFileName);
     
     std::cout << OWL_TERMINAL_GREEN << std::endl;
     std::cout << "==================================================================" << std::endl;
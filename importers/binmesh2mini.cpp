@@ -22,7 +22,7 @@ using namespace mini;
 void usage(const std::string &msg)
 {
   if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
-  std::cout << "Usage: ./binmesh2mini in.binmesh -o out.mini" << std::endl;
+  std::cout << "Usage: ./binmesh2mini in.binmesh -o out.mini [--align-arrays] [--quantize-positions <bits>] [--compress-indices] [--compress]" << std::endl;
   std::cout << "Imports a 'binmesh' formatted mesh into a mini scene.\n";
   std::cout << "Each binmesh is a binary file with the following structure:\n";
   std::cout << "  size_t numVertices\n";
@@ -36,11 +36,20 @@ int main(int ac, char **av)
 {
   std::string inFileName = "";
   std::string outFileName = "";
+  SaveOptions saveOptions;
     
   for (int i=1;i<ac;i++) {
     const std::string arg = av[i];
     if (arg == "-o") {
       outFileName = av[++i];
+    } else if (arg == "--align-arrays") {
+      saveOptions.alignArrays = true;
+    } else if (arg == "--quantize-positions") {
+      saveOptions.quantizePositionBits = std::stoi(av[++i]);
+    } else if (arg == "--compress-indices") {
+      saveOptions.compressIndices = true;
+    } else if (arg == "--compress") {
+      saveOptions.compressArrays = true;
     } else if (arg[0] != '-')
       inFileName = arg;
     else
@@ -71,7 +80,7 @@ int main(int ac, char **av)
   std::cout << OWL_TERMINAL_DEFAULT
             << "done importing; saving to " << outFileName
             << OWL_TERMINAL_DEFAULT << std::endl;
-  scene->save(outFileName);
+  scene->saveParallel(outFileName,saveOptions);
   std::cout << OWL_TERMINAL_LIGHT_GREEN
             << "scene saved"
             << OWL_TERMINAL_DEFAULT << std::endl;
@@ -14,7 +14,7 @@
 // limitations under the License.                                           //
 // ======================================================================== //
 
-#include "miniScene/Scene.h"
+#include "miniScene/SceneWriter.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -128,11 +128,11 @@ namespace mini {
       return texture;
     }
 
-    Scene::SP loadOBJ(const std::string &objFile)
+    /*! imports given OBJ file, and streams its meshes out to the
+        given writer as soon as they're created */
+    void loadOBJ(const std::string &objFile, SceneWriter &writer)
     {
-      Scene::SP scene = std::make_shared<Scene>();
-      Object::SP model = std::make_shared<Object>();
-      scene->instances.push_back(std::make_shared<Instance>(model));
+      std::vector<int> meshIDs;
       const std::string modelDir
         = objFile.substr(0,objFile.rfind('/')+1);
 
@@ -240,12 +240,12 @@ namespace mini {
           if (mesh->vertices.empty())
             /* ignore this mesh */;
           else {
-            model->meshes.push_back(mesh);
+            meshIDs.push_back(writer.add(mesh));
           }
         }
       }
 
-      return scene;
+      writer.addInstance(writer.addObject(meshIDs));
     }
 
 } // ::mini
@@ -254,7 +254,7 @@ namespace mini {
 void usage(const std::string &msg)
 {
   if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
-  std::cout << "Usage: ./obj2brix inFile.pbf -o outfile.brx" << std::endl;
+  std::cout << "Usage: ./obj2brix inFile.pbf -o outfile.brx [--align-arrays] [--quantize-positions <bits>] [--compress-indices] [--compress] [--dedup-materials]" << std::endl;
   std::cout << "Imports a OBJ+MTL file into brix's scene format.\n";
   std::cout << "(from where it can then be partitioned and/or rendered)\n";
   exit(msg != "");
@@ -264,11 +264,22 @@ int main(int ac, char **av)
 {
   std::string inFileName = "";
   std::string outFileName = "";
+  mini::SaveOptions saveOptions;
 
   for (int i=1;i<ac;i++) {
     const std::string arg = av[i];
     if (arg == "-o") {
       outFileName = av[++i];
+    } else if (arg == "--align-arrays") {
+      saveOptions.alignArrays = true;
+    } else if (arg == "--quantize-positions") {
+      saveOptions.quantizePositionBits = std::stoi(av[++i]);
+    } else if (arg == "--compress-indices") {
+      saveOptions.compressIndices = true;
+    } else if (arg == "--compress") {
+      saveOptions.compressArrays = true;
+    } else if (arg == "--dedup-materials") {
+      saveOptions.dedupMaterials = true;
     } else if (arg[0] != '-')
       inFileName = arg;
     else
@@ -282,12 +293,13 @@ int main(int ac, char **av)
             << "loading OBJ model from " << inFileName
             << MINI_COLOR_DEFAULT << std::endl;
 
-  mini::Scene::SP scene = mini::loadOBJ(inFileName);
+  mini::SceneWriter writer(outFileName,saveOptions);
+  mini::loadOBJ(inFileName,writer);
 
   std::cout << MINI_COLOR_DEFAULT
-            << "done importing; saving to " << outFileName
+            << "done importing; finishing " << outFileName
             << MINI_COLOR_DEFAULT << std::endl;
-  scene->save(outFileName);
+  writer.finish();
   std::cout << MINI_COLOR_LIGHT_GREEN
             << "scene saved"
             << MINI_COLOR_DEFAULT << std::endl;
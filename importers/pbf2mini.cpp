@@ -45,7 +45,7 @@ namespace mini {
   void usage(const std::string &msg)
   {
     if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
-    std::cout << "Usage: ./pbf2brix inFile.pbf -o outfile.mini [-t <path-to-textures>]" << std::endl;
+    std::cout << "Usage: ./pbf2brix inFile.pbf -o outfile.mini [-t <path-to-textures>] [--align-arrays] [--quantize-positions <bits>] [--compress-indices] [--compress] [--dedup-materials] [--dedup-meshes]" << std::endl;
     std::cout << "Imports a pbrt-parser/PBF file into brix's scene format.\n";
     std::cout << "(from where it can then be partitioned and/or rendered)\n";
     exit(msg != "");
@@ -713,6 +713,7 @@ Texture::SP getShapeTexture(pbrt::Shape::SP pbrtShape, const std::string &key)
   {
     std::string inFileName = "";
     std::string outFileName = "";
+    SaveOptions saveOptions;
     
     for (int i=1;i<ac;i++) {
       const std::string arg = av[i];
@@ -720,6 +721,18 @@ Texture::SP getShapeTexture(pbrt::Shape::SP pbrtShape, const std::string &key)
         outFileName = av[++i];
       } else if (arg == "-t") {
         texturePath = av[++i];
+      } else if (arg == "--align-arrays") {
+        saveOptions.alignArrays = true;
+      } else if (arg == "--quantize-positions") {
+        saveOptions.quantizePositionBits = std::stoi(av[++i]);
+      } else if (arg == "--compress-indices") {
+        saveOptions.compressIndices = true;
+      } else if (arg == "--compress") {
+        saveOptions.compressArrays = true;
+      } else if (arg == "--dedup-materials") {
+        saveOptions.dedupMaterials = true;
+      } else if (arg == "--dedup-meshes") {
+        saveOptions.dedupMeshes = true;
       } else if (arg[0] != '-')
         inFileName = arg;
       else
@@ -761,7 +774,18 @@ Texture::SP getShapeTexture(pbrt::Shape::SP pbrtShape, const std::string &key)
     std::cout << OWL_TERMINAL_DEFAULT
               << "done importing; saving to " << outFileName
               << OWL_TERMINAL_DEFAULT << std::endl;
-    scene->save(outFileName);
+    SaveStats stats = scene->saveParallel(outFileName,saveOptions);
+    if (saveOptions.dedupMeshes)
+      std::cout << "#pbf2brx: folded " << stats.numDedupedMeshes
+                << " duplicate meshes, saving "
+                << prettyNumber(stats.numDedupedMeshBytes) << "B" << std::endl;
+    if (saveOptions.dedupMaterials)
+      std::cout << "#pbf2brx: folded " << stats.numDedupedMaterials
+                << " duplicate materials" << std::endl;
+    if (stats.numDedupedTextures)
+      std::cout << "#pbf2brx: folded " << stats.numDedupedTextures
+                << " duplicate textures, saving "
+                << prettyNumber(stats.numDedupedTextureBytes) << "B" << std::endl;
     std::cout << OWL_TERMINAL_LIGHT_GREEN
               << "scene saved"
               << OWL_TERMINAL_DEFAULT << std::endl;
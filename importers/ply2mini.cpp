@@ -14,14 +14,14 @@
 // limitations under the License.                                           //
 // ======================================================================== //
 
-#include "miniScene/Scene.h"
+#include "miniScene/SceneWriter.h"
 //std
 #include <set>
 #include "happly/happly.h"
 
 namespace mini {
     
-  Scene::SP loadPLY(const std::string &plyFile)
+  Mesh::SP loadPLY(const std::string &plyFile, Material::SP material)
   {
     // number of triangles we drop due to invalid/malformed indices int he model
     size_t numDropped = 0;
@@ -30,12 +30,8 @@ namespace mini {
     std::vector<std::array<double, 3>> vPos = plyIn.getVertexPositions();
     std::vector<std::vector<size_t>>   fInd = plyIn.getFaceIndices<size_t>();
     
-
-    Material::SP dummyMaterial = std::make_shared<Material>();
-    dummyMaterial->baseColor = vec3f(.7f);
-
     Mesh::SP mesh = std::make_shared<Mesh>();
-    mesh->material = dummyMaterial;
+    mesh->material = material;
     
     for (auto v : vPos)
       mesh->vertices.push_back({(float)v[0],(float)v[1],(float)v[2]});
@@ -58,64 +54,57 @@ namespace mini {
       << " created " << prettyNumber(mesh->indices.size()) << " vertices,"
       << " and dropped " << prettyNumber(numDropped) << " triangles due to out-of-bound indices"
       << std::endl;
-
-    Object::SP model = std::make_shared<Object>();
-    model->meshes.push_back(mesh);
-    
-    Scene::SP scene = std::make_shared<Scene>();
-    scene->instances.push_back(std::make_shared<Instance>(model));
-    return scene;
+    return mesh;
   }
 
-  Scene::SP stitchStanford(const std::string &baseFileName, int numParts)
+  /*! reads the parts of a stanford scan one after another, stitches
+      each to its predecessor, and streams them out to the given
+      writer; so at any time at most two parts are in memory. Returns
+      the mesh IDs of all parts */
+  std::vector<int> stitchStanford(const std::string &baseFileName, int numParts,
+                                  Material::SP material, SceneWriter &writer)
   {
-    std::vector<Mesh::SP> meshes;
+    std::vector<int> meshIDs;
+    Mesh::SP prev;
     for (int i=0;i<numParts;i++) {
       std::stringstream ss;
       ss << baseFileName << "_" << (i+1) << ".ply";
-      Scene::SP part = loadPLY(ss.str());
-      meshes.push_back(part->instances[0]->object->meshes[0]);
-    }
-    // the stanford models come with a "matches" file that specifies
-    // which vertices in one mesh *should* be the same as those in the
-    // previous one (but due to numerical issues, are not)
-    std::cout << "read all parts ... doing overlaps" << std::endl;
-    for (int i=1;i<numParts;i++) {
-      std::stringstream ss;
-      ss << baseFileName << "_" << i << "_" << (i+1) << ".matches";
-      std::cout << "reading matches from " << ss.str() << std::endl;
-      std::ifstream in(ss.str());
-      if (!in.good())
-        throw std::runtime_error("could not read "+ss.str());
+      Mesh::SP curr = loadPLY(ss.str(),material);
+      if (prev) {
+        // the stanford models come with a "matches" file that specifies
+        // which vertices in one mesh *should* be the same as those in the
+        // previous one (but due to numerical issues, are not)
+        std::stringstream ss;
+        ss << baseFileName << "_" << i << "_" << (i+1) << ".matches";
+        std::cout << "reading matches from " << ss.str() << std::endl;
+        std::ifstream in(ss.str());
+        if (!in.good())
+          throw std::runtime_error("could not read "+ss.str());
 
-      Mesh::SP prev = meshes[i-1];
-      Mesh::SP curr = meshes[i];
-      
-      std::string line;
-      while (std::getline(in,line)) {
-        int match[2];
-        if (line[0] == '#') continue;
-        if (2 != sscanf(line.c_str(),"%i %i",&match[0],&match[1])) {
-          std::cout << "could not parse line " << line << std::endl;
-          continue;
-        }
+        std::string line;
+        while (std::getline(in,line)) {
+          int match[2];
+          if (line[0] == '#') continue;
+          if (2 != sscanf(line.c_str(),"%i %i",&match[0],&match[1])) {
+            std::cout << "could not parse line " << line << std::endl;
+            continue;
+          }
         
-        // std::cout << "match " << match[0] << "/" << prev->vertices.size()
-        //           << "  --  " << match[1] << "/" << curr->vertices.size()
-        //           << std::endl;
-        assert(match[1] <= curr->vertices.size());
-        assert(match[0] <= prev->vertices.size());
-        curr->vertices[match[1]] = prev->vertices[match[0]];
+          // std::cout << "match " << match[0] << "/" << prev->vertices.size()
+          //           << "  --  " << match[1] << "/" << curr->vertices.size()
+          //           << std::endl;
+          assert(match[1] <= curr->vertices.size());
+          assert(match[0] <= prev->vertices.size());
+          curr->vertices[match[1]] = prev->vertices[match[0]];
+        }
+        // 'prev' is final now - nothing later will modify it
+        meshIDs.push_back(writer.add(prev));
       }
+      prev = curr;
     }
-
-    Object::SP model = std::make_shared<Object>();
-    model->meshes = meshes;
-    
-    Scene::SP scene = std::make_shared<Scene>();
-    scene->instances.push_back(std::make_shared<Instance>(model));
-
-    return scene;
+    if (prev)
+      meshIDs.push_back(writer.add(prev));
+    return meshIDs;
   }
   
 } // ::mini
@@ -124,7 +113,7 @@ namespace mini {
 void usage(const std::string &msg)
 {
   if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
-  std::cout << "Usage: ./ply2brix inFile.pbf -o outfile.mini [--stanford-stitch <N>]" << std::endl;
+  std::cout << "Usage: ./ply2brix inFile.pbf -o outfile.mini [--stanford-stitch <N>] [--align-arrays] [--quantize-positions <bits>] [--compress-indices] [--compress]" << std::endl;
   std::cout << "Imports a PLY file into brix's scene format.\n";
   std::cout << "(from where it can then be partitioned and/or rendered)\n";
   std::cout << std::endl;
@@ -140,6 +129,7 @@ int main(int ac, char **av)
   std::string outFileName = "";
 
   int standordStitchParts = 0;
+  mini::SaveOptions saveOptions;
   
   for (int i=1;i<ac;i++) {
     const std::string arg = av[i];
@@ -147,6 +137,14 @@ int main(int ac, char **av)
       outFileName = av[++i];
     } else if (arg == "--stanford-stitch") {
       standordStitchParts = std::stoi(av[++i]);
+    } else if (arg == "--align-arrays") {
+      saveOptions.alignArrays = true;
+    } else if (arg == "--quantize-positions") {
+      saveOptions.quantizePositionBits = std::stoi(av[++i]);
+    } else if (arg == "--compress-indices") {
+      saveOptions.compressIndices = true;
+    } else if (arg == "--compress") {
+      saveOptions.compressArrays = true;
     } else if (arg[0] != '-')
       inFileName = arg;
     else
@@ -160,15 +158,23 @@ int main(int ac, char **av)
             << "loading PLY model from " << inFileName
             << OWL_TERMINAL_DEFAULT << std::endl;
   
-  mini::Scene::SP scene
+  // parts get written out as soon as they're loaded, so we never
+  // have to hold the entire model in memory
+  mini::SceneWriter writer(outFileName,saveOptions);
+  
+  mini::Material::SP dummyMaterial = std::make_shared<mini::Material>();
+  dummyMaterial->baseColor = mini::vec3f(.7f);
+
+  std::vector<int> meshIDs
     = standordStitchParts
-    ? mini::stitchStanford(inFileName,standordStitchParts)
-    : mini::loadPLY(inFileName);
+    ? mini::stitchStanford(inFileName,standordStitchParts,dummyMaterial,writer)
+    : std::vector<int>{ writer.add(mini::loadPLY(inFileName,dummyMaterial)) };
   
   std::cout << OWL_TERMINAL_DEFAULT
-            << "done importing; saving to " << outFileName
+            << "done importing; finishing " << outFileName
             << OWL_TERMINAL_DEFAULT << std::endl;
-  scene->save(outFileName);
+  writer.addInstance(writer.addObject(meshIDs));
+  writer.finish();
   std::cout << OWL_TERMINAL_LIGHT_GREEN
             << "scene saved"
             << OWL_TERMINAL_DEFAULT << std::endl;
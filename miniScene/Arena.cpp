@@ -0,0 +1,58 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/Arena.h"
+
+namespace mini {
+
+  Arena::~Arena()
+  {
+    for (auto block : blocks)
+      free(block);
+  }
+  
+  void *Arena::allocate(size_t numBytes, size_t alignment)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    numBytesAllocated += numBytes;
+    if (numBytes > MAX_SHARED_SIZE) {
+      uint8_t *block = (uint8_t *)malloc(numBytes+alignment);
+      if (!block) throw std::bad_alloc();
+      blocks.push_back(block);
+      return block + (alignment - (size_t)block % alignment) % alignment;
+    }
+    size_t padding = (alignment - (size_t)next % alignment) % alignment;
+    if (!next || padding+numBytes > remaining) {
+      next = (uint8_t *)malloc(BLOCK_SIZE);
+      if (!next) throw std::bad_alloc();
+      blocks.push_back(next);
+      remaining = BLOCK_SIZE;
+      padding   = (alignment - (size_t)next % alignment) % alignment;
+    }
+    uint8_t *ptr = next+padding;
+    next      += padding+numBytes;
+    remaining -= padding+numBytes;
+    return ptr;
+  }
+
+  size_t Arena::getNumBytesAllocated() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numBytesAllocated;
+  }
+  
+} // ::mini
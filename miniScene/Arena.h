@@ -0,0 +1,125 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/common.h"
+#include "miniScene/Array.h"
+// std
+#include <cstddef>
+#include <mutex>
+
+namespace mini {
+
+  /*! memory for scene graph nodes and their arrays, bump-allocated
+      from large blocks, and released all at once when the arena
+      dies. Scenes loaded with LoadOptions::useArena keep all their
+      instances, objects, meshes and materials (and the meshes'
+      arrays) in an arena, so loading them takes a handful of large
+      allocations rather than several per node, and destroying them
+      never frees any individual nodes.
+
+      Nodes created with make() are regular shared_ptr's, with their
+      own reference counts; they get destroyed when their last
+      reference goes away, just like any other node. Every one of them
+      (and every array from allocateArray()) also holds a reference
+      to the arena, so the arena's memory stays around for as long as
+      anybody still uses any of it (including weak_ptr's to nodes, as
+      for std::make_shared). Arenas have to be created through
+      create(). Thread-safe. */
+  struct Arena : public std::enable_shared_from_this<Arena> {
+    typedef std::shared_ptr<Arena> SP;
+
+    static SP create() { return std::make_shared<Arena>(); }
+    
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    /*! releases the arena's memory; everything in it is dead by
+        then */
+    ~Arena();
+    
+    /*! returns 'numBytes' bytes of uninitialized memory */
+    void *allocate(size_t numBytes, size_t alignment = alignof(std::max_align_t));
+
+    /*! creates a default-constructed T (and its reference count) in
+        this arena; eg, arena->make<Mesh>(). When creating many nodes
+        of the same type, ArenaAllocator::make() is cheaper */
+    template<typename T>
+    std::shared_ptr<T> make();
+
+    /*! returns a view of N uninitialized elements in this arena; for
+        types that can be copied as raw bytes. Resizing that array
+        moves it out of the arena, just like for any other view */
+    template<typename T>
+    Array<T> allocateArray(size_t N)
+    {
+      if (N == 0) return {};
+      return Array<T>::view((T*)allocate(N*sizeof(T),alignof(T)),N,shared_from_this());
+    }
+
+    /*! number of bytes handed out so far (not counting padding) */
+    size_t getNumBytesAllocated() const;
+    
+  private:
+    /*! allocations up to this size come from shared blocks of
+        BLOCK_SIZE bytes; larger ones get blocks of their own */
+    static const size_t BLOCK_SIZE      = size_t(1) << 20;
+    static const size_t MAX_SHARED_SIZE = BLOCK_SIZE/8;
+    
+    mutable std::mutex      mutex;
+    std::vector<void *>     blocks;
+    /*! unused part of the current shared block */
+    uint8_t *next      { nullptr };
+    size_t   remaining { 0 };
+    size_t   numBytesAllocated { 0 };
+  };
+
+  /*! a std allocator handing out memory from an arena (which it keeps
+      alive); deallocating does nothing, the memory gets released with
+      the arena */
+  template<typename T>
+  struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator(const Arena::SP &arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t N) { return (T*)arena->allocate(N*sizeof(T),alignof(T)); }
+    void deallocate(T *, size_t) {}
+
+    /*! creates a default-constructed T (and its reference count) in
+        the arena */
+    std::shared_ptr<T> make() const { return std::allocate_shared<T>(*this); }
+
+    Arena::SP arena;
+  };
+
+  template<typename T, typename U>
+  inline bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+  { return a.arena == b.arena; }
+  
+  template<typename T, typename U>
+  inline bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+  { return a.arena != b.arena; }
+
+  template<typename T>
+  std::shared_ptr<T> Arena::make()
+  { return ArenaAllocator<T>(shared_from_this()).make(); }
+  
+} // ::mini
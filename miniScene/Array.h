@@ -0,0 +1,136 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+// std
+#include <initializer_list>
+#include <memory>
+
+namespace mini {
+
+  /*! a std::vector-like array that either owns its elements (in
+      which case it behaves exactly like a std::vector), or that is a
+      'view' into a range of memory owned by somebody else - typically
+      a memory-mapped .mini file. A view keeps its owner alive through
+      a shared_ptr, so the underlying mapping stays valid for as long
+      as any array still refers to it.
+
+      Elements of a view can be read and modified in place (mapped
+      files use copy-on-write pages, so this never touches the file);
+      any operation that changes the array's size will first copy the
+      viewed elements into owned storage. Copying an array always
+      creates an owned deep copy, exactly as a std::vector would. */
+  template<typename T>
+  struct Array {
+    typedef T        value_type;
+    typedef T       *iterator;
+    typedef const T *const_iterator;
+
+    Array() = default;
+    Array(size_t N, const T &t = T()) : owned(N,t) {}
+    Array(const std::vector<T> &v) : owned(v) {}
+    Array(std::vector<T> &&v) : owned(std::move(v)) {}
+    Array(std::initializer_list<T> il) : owned(il) {}
+    Array(const Array &other) : owned(other.begin(),other.end()) {}
+    Array(Array &&other) { *this = std::move(other); }
+
+    /*! creates a view of N elements at given address; 'owner' is
+        whatever needs to stay alive for this memory to remain
+        valid */
+    static Array view(T *ptr, size_t N, std::shared_ptr<void> owner)
+    {
+      Array array;
+      array.viewPtr  = ptr;
+      array.viewSize = N;
+      array.owner    = owner;
+      return array;
+    }
+
+    Array &operator=(const Array &other)
+    {
+      if (this == &other) return *this;
+      std::vector<T> copy(other.begin(),other.end());
+      releaseView();
+      owned = std::move(copy);
+      return *this;
+    }
+
+    Array &operator=(Array &&other)
+    {
+      if (this == &other) return *this;
+      owned    = std::move(other.owned);
+      viewPtr  = other.viewPtr;
+      viewSize = other.viewSize;
+      owner    = std::move(other.owner);
+      other.owned.clear();
+      other.releaseView();
+      return *this;
+    }
+
+    /*! returns whether this array refers to memory it does not own */
+    inline bool isView() const { return viewPtr != nullptr; }
+
+    inline size_t   size()  const { return isView() ? viewSize : owned.size(); }
+    inline bool     empty() const { return size() == 0; }
+    inline T       *data()        { return isView() ? viewPtr : owned.data(); }
+    inline const T *data()  const { return isView() ? viewPtr : owned.data(); }
+
+    inline T       &operator[](size_t i)       { assert(i < size()); return data()[i]; }
+    inline const T &operator[](size_t i) const { assert(i < size()); return data()[i]; }
+
+    inline T       *begin()       { return data(); }
+    inline T       *end()         { return data()+size(); }
+    inline const T *begin() const { return data(); }
+    inline const T *end()   const { return data()+size(); }
+
+    inline T       &front()       { return data()[0]; }
+    inline const T &front() const { return data()[0]; }
+    inline T       &back()        { return data()[size()-1]; }
+    inline const T &back()  const { return data()[size()-1]; }
+
+    void push_back(const T &t) { detach(); owned.push_back(t); }
+    void reserve(size_t N)     { detach(); owned.reserve(N); }
+    void resize(size_t N)      { detach(); owned.resize(N); }
+    void resize(size_t N, const T &t) { detach(); owned.resize(N,t); }
+    void clear()               { releaseView(); owned.clear(); }
+    void shrink_to_fit()       { if (!isView()) owned.shrink_to_fit(); }
+
+    /*! if this is a view, copies the viewed elements into owned
+        storage and drops the reference to the view's owner */
+    void detach()
+    {
+      if (!isView()) return;
+      owned.assign(viewPtr,viewPtr+viewSize);
+      releaseView();
+    }
+
+  private:
+    void releaseView()
+    {
+      viewPtr  = nullptr;
+      viewSize = 0;
+      owner.reset();
+    }
+
+    std::vector<T>        owned;
+    T                    *viewPtr  { nullptr };
+    size_t                viewSize { 0 };
+    std::shared_ptr<void> owner;
+  };
+
+} // ::mini
@@ -0,0 +1,96 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/AsyncLoad.h"
+
+namespace mini {
+
+  AsyncLoad::~AsyncLoad()
+  {
+    cancel();
+    if (thread.joinable())
+      thread.join();
+  }
+
+  void AsyncLoad::cancel()
+  {
+    cancelled = true;
+  }
+
+  /*! throws whatever ended a load that did not complete */
+  inline void throwFailure(AsyncLoad::Stage stage, std::exception_ptr error)
+  {
+    if (stage == AsyncLoad::FAILED && error)
+      std::rethrow_exception(error);
+    throw std::runtime_error("scene load was cancelled");
+  }
+  
+  Scene::SP AsyncLoad::waitForGeometry()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stageChanged.wait(lock,[&]{ return stage != LOADING_GEOMETRY; });
+    if (!scene)
+      throwFailure(stage,error);
+    return scene;
+  }
+
+  Scene::SP AsyncLoad::wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stageChanged.wait(lock,[&]{
+        return stage != LOADING_GEOMETRY && stage != LOADING_TEXTURES;
+      });
+    if (stage != DONE)
+      throwFailure(stage,error);
+    return scene;
+  }
+
+  AsyncLoad::Stage AsyncLoad::getStage()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stage;
+  }
+
+  AsyncLoad::Progress AsyncLoad::getProgress() const
+  {
+    Progress progress;
+    progress.bytesRead      = bytesRead;
+    progress.totalBytes     = totalBytes;
+    progress.meshesLoaded   = meshesLoaded;
+    progress.numMeshes      = numMeshes;
+    progress.texturesLoaded = texturesLoaded;
+    progress.numTextures    = numTextures;
+    return progress;
+  }
+
+  void AsyncLoad::geometryLoaded(Scene::SP scene)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->scene = scene;
+    stage = LOADING_TEXTURES;
+    stageChanged.notify_all();
+  }
+
+  void AsyncLoad::finished(Stage stage, std::exception_ptr error)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->stage = stage;
+    this->error = error;
+    stageChanged.notify_all();
+  }
+  
+} // ::mini
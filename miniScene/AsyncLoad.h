@@ -0,0 +1,113 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/Scene.h"
+// std
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+
+namespace mini {
+
+  /*! handle to a scene that is being loaded in the background by
+      Scene::loadAsync(). The load happens in two phases: first
+      everything except texture data (materials, meshes, objects,
+      instances, lights), after which the scene can be obtained
+      through waitForGeometry(); and then the texels, which get read
+      directly into the Texture objects the scene's materials already
+      point to. Until wait() has returned, consumers may use the
+      scene's geometry (say, to build acceleration structures) but
+      must not access any texture's size, format, or data.
+
+      Destroying the handle cancels the load and waits for the
+      loading thread to finish. All methods are thread-safe */
+  struct AsyncLoad {
+    typedef std::shared_ptr<AsyncLoad> SP;
+
+    typedef enum {
+      LOADING_GEOMETRY=0, LOADING_TEXTURES, DONE, FAILED, CANCELLED
+    } Stage;
+
+    /*! snapshot of how far the load has come; 'total' values are 0
+        until the file's TOC has been read */
+    struct Progress {
+      size_t bytesRead      { 0 };
+      size_t totalBytes     { 0 };
+      size_t meshesLoaded   { 0 };
+      size_t numMeshes      { 0 };
+      size_t texturesLoaded { 0 };
+      size_t numTextures    { 0 };
+    };
+
+    ~AsyncLoad();
+
+    /*! asks the loading thread to stop at the next record; wait()
+        (and, if the geometry isn't complete yet, waitForGeometry())
+        will then throw */
+    void cancel();
+
+    /*! blocks until all geometry is loaded, then returns the scene
+        (whose textures may still be loading); throws if the load
+        failed or got cancelled before that */
+    Scene::SP waitForGeometry();
+
+    /*! blocks until the load has completed, then returns the scene;
+        throws if the load failed or got cancelled */
+    Scene::SP wait();
+
+    Stage    getStage();
+    Progress getProgress() const;
+
+    // ------------------------------------------------------------------
+    // the following are only to be used by the loading thread
+    // ------------------------------------------------------------------
+
+    /*! thrown by checkCancelled() */
+    struct Cancelled {};
+
+    /*! throws Cancelled if cancel() was called */
+    void checkCancelled() const { if (cancelled) throw Cancelled(); }
+
+    /*! makes the scene available to waitForGeometry(), and moves on
+        to loading textures */
+    void geometryLoaded(Scene::SP scene);
+
+    /*! marks the load as finished, successfully or not */
+    void finished(Stage stage, std::exception_ptr error = nullptr);
+
+    std::atomic<size_t> bytesRead      { 0 };
+    std::atomic<size_t> totalBytes     { 0 };
+    std::atomic<size_t> meshesLoaded   { 0 };
+    std::atomic<size_t> numMeshes      { 0 };
+    std::atomic<size_t> texturesLoaded { 0 };
+    std::atomic<size_t> numTextures    { 0 };
+
+    std::thread thread;
+    
+  private:
+    std::atomic<bool>       cancelled { false };
+    std::mutex              mutex;
+    std::condition_variable stageChanged;
+    Stage                   stage { LOADING_GEOMETRY };
+    Scene::SP               scene;
+    std::exception_ptr      error;
+  };
+
+} // ::mini
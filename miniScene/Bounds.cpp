@@ -0,0 +1,285 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/Bounds.h"
+#include "miniScene/Scene.h"
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+# define MINI_BOUNDS_X86 1
+# include <immintrin.h>
+#endif
+
+namespace mini {
+
+  /*! number of points each thread of parallelComputeBounds() works
+      on at a time */
+  static const size_t POINTS_PER_TASK = 64*1024;
+  
+  /*! the kernels below go through points as a plain array of floats,
+      and through transforms as arrays of 12 floats (vx,vy,vz,p) */
+  static_assert(sizeof(vec3f) == 3*sizeof(float),"unexpected vec3f layout");
+  static_assert(sizeof(box3f) == 6*sizeof(float),"unexpected box3f layout");
+  static_assert(sizeof(affine3f) == 12*sizeof(float),"unexpected affine3f layout");
+
+  static box3f pointsScalar(const vec3f *points, size_t N)
+  {
+    box3f bounds;
+    for (size_t i=0;i<N;i++)
+      bounds.extend(points[i]);
+    return bounds;
+  }
+
+  /*! the vector kernels keep three min and three max registers of W
+      floats each, and load 3*W floats (W points) per iteration; float
+      #k of those registers then always holds component k%3 of some
+      point. This folds such registers - stored to memory - into
+      'bounds' */
+  static void reduceLanes(const float *mins, const float *maxs, size_t numFloats,
+                          box3f &bounds)
+  {
+    for (size_t k=0;k<numFloats;k++) {
+      bounds.lower[k%3] = std::min(bounds.lower[k%3],mins[k]);
+      bounds.upper[k%3] = std::max(bounds.upper[k%3],maxs[k]);
+    }
+  }
+  
+#if MINI_BOUNDS_X86
+# ifdef __SSE2__
+  static box3f pointsSSE(const vec3f *points, size_t N)
+  {
+    const float *f = (const float *)points;
+    __m128 min0 = _mm_set1_ps(+std::numeric_limits<float>::infinity());
+    __m128 max0 = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 min1 = min0, min2 = min0;
+    __m128 max1 = max0, max2 = max0;
+    size_t i = 0;
+    for (;i+4<=N;i+=4,f+=12) {
+      const __m128 v0 = _mm_loadu_ps(f+0);
+      const __m128 v1 = _mm_loadu_ps(f+4);
+      const __m128 v2 = _mm_loadu_ps(f+8);
+      min0 = _mm_min_ps(min0,v0); max0 = _mm_max_ps(max0,v0);
+      min1 = _mm_min_ps(min1,v1); max1 = _mm_max_ps(max1,v1);
+      min2 = _mm_min_ps(min2,v2); max2 = _mm_max_ps(max2,v2);
+    }
+    float mins[12], maxs[12];
+    _mm_storeu_ps(mins+0,min0); _mm_storeu_ps(maxs+0,max0);
+    _mm_storeu_ps(mins+4,min1); _mm_storeu_ps(maxs+4,max1);
+    _mm_storeu_ps(mins+8,min2); _mm_storeu_ps(maxs+8,max2);
+    box3f bounds = pointsScalar(points+i,N-i);
+    reduceLanes(mins,maxs,12,bounds);
+    return bounds;
+  }
+
+  /*! computes the bounds of a transformed box as in xfmBox(), one
+      box per SSE register (the fourth lane is ignored) */
+  static box3f boxesSSE(const affine3f *xfms, const box3f *boxes, size_t N)
+  {
+    __m128 lower = _mm_set1_ps(+std::numeric_limits<float>::infinity());
+    __m128 upper = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    for (size_t i=0;i<N;i++) {
+      const float *m = (const float *)&xfms[i];
+      const float *b = (const float *)&boxes[i];
+      const __m128 vx = _mm_loadu_ps(m+0);
+      const __m128 vy = _mm_loadu_ps(m+3);
+      const __m128 vz = _mm_loadu_ps(m+6);
+      const __m128 p8 = _mm_loadu_ps(m+8);
+      const __m128 p  = _mm_shuffle_ps(p8,p8,_MM_SHUFFLE(3,3,2,1));
+      const __m128 lo = _mm_loadu_ps(b+0);
+      const __m128 h2 = _mm_loadu_ps(b+2);
+      const __m128 hi = _mm_shuffle_ps(h2,h2,_MM_SHUFFLE(3,3,2,1));
+
+      __m128 l = p, u = p;
+      __m128 a = _mm_mul_ps(vx,_mm_shuffle_ps(lo,lo,_MM_SHUFFLE(0,0,0,0)));
+      __m128 c = _mm_mul_ps(vx,_mm_shuffle_ps(hi,hi,_MM_SHUFFLE(0,0,0,0)));
+      l = _mm_add_ps(l,_mm_min_ps(a,c)); u = _mm_add_ps(u,_mm_max_ps(a,c));
+      a = _mm_mul_ps(vy,_mm_shuffle_ps(lo,lo,_MM_SHUFFLE(1,1,1,1)));
+      c = _mm_mul_ps(vy,_mm_shuffle_ps(hi,hi,_MM_SHUFFLE(1,1,1,1)));
+      l = _mm_add_ps(l,_mm_min_ps(a,c)); u = _mm_add_ps(u,_mm_max_ps(a,c));
+      a = _mm_mul_ps(vz,_mm_shuffle_ps(lo,lo,_MM_SHUFFLE(2,2,2,2)));
+      c = _mm_mul_ps(vz,_mm_shuffle_ps(hi,hi,_MM_SHUFFLE(2,2,2,2)));
+      l = _mm_add_ps(l,_mm_min_ps(a,c)); u = _mm_add_ps(u,_mm_max_ps(a,c));
+      
+      lower = _mm_min_ps(lower,l);
+      upper = _mm_max_ps(upper,u);
+    }
+    float l[4], u[4];
+    _mm_storeu_ps(l,lower);
+    _mm_storeu_ps(u,upper);
+    return box3f(vec3f(l[0],l[1],l[2]),vec3f(u[0],u[1],u[2]));
+  }
+# endif
+  
+  __attribute__((target("avx2")))
+  static box3f pointsAVX2(const vec3f *points, size_t N)
+  {
+    const float *f = (const float *)points;
+    __m256 min0 = _mm256_set1_ps(+std::numeric_limits<float>::infinity());
+    __m256 max0 = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256 min1 = min0, min2 = min0;
+    __m256 max1 = max0, max2 = max0;
+    size_t i = 0;
+    for (;i+8<=N;i+=8,f+=24) {
+      const __m256 v0 = _mm256_loadu_ps(f+0);
+      const __m256 v1 = _mm256_loadu_ps(f+8);
+      const __m256 v2 = _mm256_loadu_ps(f+16);
+      min0 = _mm256_min_ps(min0,v0); max0 = _mm256_max_ps(max0,v0);
+      min1 = _mm256_min_ps(min1,v1); max1 = _mm256_max_ps(max1,v1);
+      min2 = _mm256_min_ps(min2,v2); max2 = _mm256_max_ps(max2,v2);
+    }
+    float mins[24], maxs[24];
+    _mm256_storeu_ps(mins+0, min0); _mm256_storeu_ps(maxs+0, max0);
+    _mm256_storeu_ps(mins+8, min1); _mm256_storeu_ps(maxs+8, max1);
+    _mm256_storeu_ps(mins+16,min2); _mm256_storeu_ps(maxs+16,max2);
+    box3f bounds = pointsScalar(points+i,N-i);
+    reduceLanes(mins,maxs,24,bounds);
+    return bounds;
+  }
+
+  /* GCC's _mm512_min_ps/_mm512_max_ps fill their (never masked off)
+     pass-through lanes from _mm512_undefined_ps(), which trips
+     -Wmaybe-uninitialized; the masked forms with all lanes enabled
+     compute the same, without that */
+  __attribute__((target("avx512f")))
+  static inline __m512 min16(__m512 a, __m512 b)
+  { return _mm512_mask_min_ps(a,(__mmask16)0xffff,a,b); }
+  
+  __attribute__((target("avx512f")))
+  static inline __m512 max16(__m512 a, __m512 b)
+  { return _mm512_mask_max_ps(a,(__mmask16)0xffff,a,b); }
+  
+  __attribute__((target("avx512f")))
+  static box3f pointsAVX512(const vec3f *points, size_t N)
+  {
+    const float *f = (const float *)points;
+    __m512 min0 = _mm512_set1_ps(+std::numeric_limits<float>::infinity());
+    __m512 max0 = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+    __m512 min1 = min0, min2 = min0;
+    __m512 max1 = max0, max2 = max0;
+    size_t i = 0;
+    for (;i+16<=N;i+=16,f+=48) {
+      const __m512 v0 = _mm512_loadu_ps(f+0);
+      const __m512 v1 = _mm512_loadu_ps(f+16);
+      const __m512 v2 = _mm512_loadu_ps(f+32);
+      min0 = min16(min0,v0); max0 = max16(max0,v0);
+      min1 = min16(min1,v1); max1 = max16(max1,v1);
+      min2 = min16(min2,v2); max2 = max16(max2,v2);
+    }
+    float mins[48], maxs[48];
+    _mm512_storeu_ps(mins+0, min0); _mm512_storeu_ps(maxs+0, max0);
+    _mm512_storeu_ps(mins+16,min1); _mm512_storeu_ps(maxs+16,max1);
+    _mm512_storeu_ps(mins+32,min2); _mm512_storeu_ps(maxs+32,max2);
+    box3f bounds = pointsScalar(points+i,N-i);
+    reduceLanes(mins,maxs,48,bounds);
+    return bounds;
+  }
+#endif
+
+  static box3f boxesScalar(const affine3f *xfms, const box3f *boxes, size_t N)
+  {
+    box3f bounds;
+    for (size_t i=0;i<N;i++)
+      bounds.extend(xfmBox(xfms[i],boxes[i]));
+    return bounds;
+  }
+  
+  /*! the widest instruction set this CPU supports */
+  static BoundsISA bestISA()
+  {
+#if MINI_BOUNDS_X86
+    static const BoundsISA best
+      = __builtin_cpu_supports("avx512f") ? BOUNDS_ISA_AVX512
+      : __builtin_cpu_supports("avx2")    ? BOUNDS_ISA_AVX2
+# ifdef __SSE2__
+      : BOUNDS_ISA_SSE;
+# else
+      : BOUNDS_ISA_SCALAR;
+# endif
+    return best;
+#else
+    return BOUNDS_ISA_SCALAR;
+#endif
+  }
+
+  bool isSupported(BoundsISA isa)
+  {
+    return isa <= bestISA();
+  }
+
+  std::string toString(BoundsISA isa)
+  {
+    switch (isa == BOUNDS_ISA_AUTO ? bestISA() : isa) {
+    case BOUNDS_ISA_SCALAR: return "scalar";
+    case BOUNDS_ISA_SSE:    return "sse";
+    case BOUNDS_ISA_AVX2:   return "avx2";
+    case BOUNDS_ISA_AVX512: return "avx512";
+    default:                return "<unknown>";
+    }
+  }
+
+  /*! resolves BOUNDS_ISA_AUTO, and checks that the CPU supports the
+      one requested */
+  static BoundsISA checkISA(BoundsISA isa)
+  {
+    if (isa == BOUNDS_ISA_AUTO)
+      return bestISA();
+    if (!isSupported(isa))
+      throw std::runtime_error("bounds kernels: instruction set '"+toString(isa)
+                               +"' not supported on this CPU");
+    return isa;
+  }
+  
+  box3f computeBounds(const vec3f *points, size_t N, BoundsISA isa)
+  {
+    switch (checkISA(isa)) {
+#if MINI_BOUNDS_X86
+    case BOUNDS_ISA_AVX512: return pointsAVX512(points,N);
+    case BOUNDS_ISA_AVX2:   return pointsAVX2(points,N);
+# ifdef __SSE2__
+    case BOUNDS_ISA_SSE:    return pointsSSE(points,N);
+# endif
+#endif
+    default:                return pointsScalar(points,N);
+    }
+  }
+
+  box3f parallelComputeBounds(const vec3f *points, size_t N)
+  {
+    if (N <= POINTS_PER_TASK)
+      return computeBounds(points,N);
+    
+    std::vector<box3f> taskBounds((N+POINTS_PER_TASK-1)/POINTS_PER_TASK);
+    parallel_for_blocked(0,N,POINTS_PER_TASK,[&](size_t begin, size_t end){
+        taskBounds[begin/POINTS_PER_TASK] = computeBounds(points+begin,end-begin);
+      });
+    box3f bounds;
+    for (auto &box : taskBounds)
+      bounds.extend(box);
+    return bounds;
+  }
+  
+  box3f computeBounds(const affine3f *xfms, const box3f *boxes, size_t N,
+                      BoundsISA isa)
+  {
+#if MINI_BOUNDS_X86 && defined(__SSE2__)
+    if (checkISA(isa) >= BOUNDS_ISA_SSE)
+      return boxesSSE(xfms,boxes,N);
+#else
+    checkISA(isa);
+#endif
+    return boxesScalar(xfms,boxes,N);
+  }
+  
+} // ::mini
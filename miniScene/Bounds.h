@@ -0,0 +1,61 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+
+  /*! the instruction sets the bounds kernels below come in */
+  typedef enum {
+    /*! the widest one this CPU supports */
+    BOUNDS_ISA_AUTO = 0,
+    BOUNDS_ISA_SCALAR,
+    BOUNDS_ISA_SSE,
+    BOUNDS_ISA_AVX2,
+    BOUNDS_ISA_AVX512
+  } BoundsISA;
+
+  /*! whether the bounds kernels can use given instruction set on
+      this CPU (and in this build) */
+  bool isSupported(BoundsISA isa);
+
+  /*! name of given instruction set, like "avx2"; for
+      BOUNDS_ISA_AUTO, the name of the one that this actually picks
+      on this CPU */
+  std::string toString(BoundsISA isa);
+  
+  /*! returns the bounding box of the given N points, on the calling
+      thread; throws if the CPU does not support the requested
+      instruction set */
+  box3f computeBounds(const vec3f *points, size_t N,
+                      BoundsISA isa = BOUNDS_ISA_AUTO);
+
+  /*! same as computeBounds(), but splits large arrays across all
+      threads */
+  box3f parallelComputeBounds(const vec3f *points, size_t N);
+
+  /*! returns the union of xfmBox(xfms[i],boxes[i]) over all N given
+      transform/box pairs, on the calling thread. None of the boxes
+      may be empty. There only is a scalar and an SSE version of
+      this kernel (it's as much about loading transforms as about
+      math), which the wider instruction sets fall back to */
+  box3f computeBounds(const affine3f *xfms, const box3f *boxes, size_t N,
+                      BoundsISA isa = BOUNDS_ISA_AUTO);
+  
+} // ::mini
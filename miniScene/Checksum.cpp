@@ -0,0 +1,205 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/Checksum.h"
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+# define MINI_CRC32C_SSE42 1
+# include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+# define MINI_CRC32C_ARMV8 1
+# include <arm_acle.h>
+#endif
+
+namespace mini {
+
+  /*! CRC32C polynomial, bit-reversed */
+  static const uint32_t CRC32C_POLY = 0x82F63B78u;
+
+  /*! tables for computing CRC32C in software, eight bytes at a time
+      ('slicing-by-8'): table[0] is the classic byte-at-a-time table,
+      table[k] advances a byte's contribution by k more bytes */
+  struct CRC32CTables {
+    CRC32CTables()
+    {
+      for (uint32_t i=0;i<256;i++) {
+        uint32_t crc = i;
+        for (int bit=0;bit<8;bit++)
+          crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        table[0][i] = crc;
+      }
+      for (uint32_t i=0;i<256;i++)
+        for (int k=1;k<8;k++)
+          table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xff];
+    }
+    uint32_t table[8][256];
+  };
+  
+  static uint32_t crc32cSoftware(uint32_t crc, const uint8_t *ptr, size_t numBytes)
+  {
+    static const CRC32CTables tables;
+    const uint32_t (*table)[256] = tables.table;
+    for (;numBytes && ((size_t)ptr & 7);numBytes--)
+      crc = (crc >> 8) ^ table[0][(crc ^ *ptr++) & 0xff];
+    for (;numBytes >= 8;numBytes -= 8, ptr += 8) {
+      uint32_t lo, hi;
+      memcpy(&lo,ptr,4);
+      memcpy(&hi,ptr+4,4);
+      lo ^= crc;
+      crc =
+        table[7][ lo        & 0xff] ^ table[6][(lo >>  8) & 0xff] ^
+        table[5][(lo >> 16) & 0xff] ^ table[4][ lo >> 24        ] ^
+        table[3][ hi        & 0xff] ^ table[2][(hi >>  8) & 0xff] ^
+        table[1][(hi >> 16) & 0xff] ^ table[0][ hi >> 24        ];
+    }
+    for (;numBytes;numBytes--)
+      crc = (crc >> 8) ^ table[0][(crc ^ *ptr++) & 0xff];
+    return crc;
+  }
+
+#if MINI_CRC32C_SSE42
+# ifdef __x86_64__
+  /*! number of bytes each of the three interleaved streams of
+      crc32cHardware() processes per round */
+  static const size_t STREAM_BYTES = 4096;
+
+  /*! advancing a (non-inverted) CRC state over N zero bytes is a
+      linear function of that state; this tabulates it for N =
+      STREAM_BYTES, one table per byte of the state */
+  struct CRC32CShift {
+    CRC32CShift()
+    {
+      uint32_t basis[32];
+      for (int bit=0;bit<32;bit++) {
+        uint32_t crc = 1u << bit;
+        for (size_t i=0;i<STREAM_BYTES*8;i++)
+          crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        basis[bit] = crc;
+      }
+      for (int k=0;k<4;k++)
+        for (uint32_t b=0;b<256;b++) {
+          uint32_t shifted = 0;
+          for (int bit=0;bit<8;bit++)
+            if (b & (1u << bit)) shifted ^= basis[8*k+bit];
+          table[k][b] = shifted;
+        }
+    }
+
+    inline uint32_t operator()(uint32_t crc) const
+    {
+      return
+        table[0][ crc        & 0xff] ^ table[1][(crc >>  8) & 0xff] ^
+        table[2][(crc >> 16) & 0xff] ^ table[3][ crc >> 24        ];
+    }
+    
+    uint32_t table[4][256];
+  };
+# endif
+  
+  /*! compiled for SSE4.2 no matter what the rest of the library gets
+      compiled for; only gets called if the CPU has it */
+  __attribute__((target("sse4.2")))
+  static uint32_t crc32cHardware(uint32_t crc, const uint8_t *ptr, size_t numBytes)
+  {
+    for (;numBytes && ((size_t)ptr & 7);numBytes--)
+      crc = _mm_crc32_u8(crc,*ptr++);
+# ifdef __x86_64__
+    /* the crc32 instruction has a latency of three cycles, but can
+       start one per cycle; so for large inputs, run three independent
+       streams over adjacent blocks, and then combine their CRCs */
+    if (numBytes >= 3*STREAM_BYTES) {
+      static const CRC32CShift shift;
+      for (;numBytes >= 3*STREAM_BYTES;
+           numBytes -= 3*STREAM_BYTES, ptr += 3*STREAM_BYTES) {
+        uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+        for (size_t i=0;i<STREAM_BYTES;i+=8) {
+          uint64_t v0, v1, v2;
+          memcpy(&v0,ptr+i,8);
+          memcpy(&v1,ptr+STREAM_BYTES+i,8);
+          memcpy(&v2,ptr+2*STREAM_BYTES+i,8);
+          crc0 = _mm_crc32_u64(crc0,v0);
+          crc1 = _mm_crc32_u64(crc1,v1);
+          crc2 = _mm_crc32_u64(crc2,v2);
+        }
+        crc = shift(shift((uint32_t)crc0) ^ (uint32_t)crc1) ^ (uint32_t)crc2;
+      }
+    }
+    uint64_t crc64 = crc;
+    for (;numBytes >= 8;numBytes -= 8, ptr += 8) {
+      uint64_t v;
+      memcpy(&v,ptr,8);
+      crc64 = _mm_crc32_u64(crc64,v);
+    }
+    crc = (uint32_t)crc64;
+# endif
+    for (;numBytes >= 4;numBytes -= 4, ptr += 4) {
+      uint32_t v;
+      memcpy(&v,ptr,4);
+      crc = _mm_crc32_u32(crc,v);
+    }
+    for (;numBytes;numBytes--)
+      crc = _mm_crc32_u8(crc,*ptr++);
+    return crc;
+  }
+
+  static bool haveHardwareCRC()
+  {
+    static const bool haveSSE42 = __builtin_cpu_supports("sse4.2");
+    return haveSSE42;
+  }
+#elif MINI_CRC32C_ARMV8
+  static uint32_t crc32cHardware(uint32_t crc, const uint8_t *ptr, size_t numBytes)
+  {
+    for (;numBytes && ((size_t)ptr & 7);numBytes--)
+      crc = __crc32cb(crc,*ptr++);
+    for (;numBytes >= 8;numBytes -= 8, ptr += 8) {
+      uint64_t v;
+      memcpy(&v,ptr,8);
+      crc = __crc32cd(crc,v);
+    }
+    for (;numBytes;numBytes--)
+      crc = __crc32cb(crc,*ptr++);
+    return crc;
+  }
+
+  /*! the compiler only defines __ARM_FEATURE_CRC32 if the targeted
+      CPUs all have the CRC instructions */
+  static bool haveHardwareCRC()
+  { return true; }
+#else
+  static uint32_t crc32cHardware(uint32_t crc, const uint8_t *ptr, size_t numBytes)
+  { return crc32cSoftware(crc,ptr,numBytes); }
+  
+  static bool haveHardwareCRC()
+  { return false; }
+#endif
+  
+  uint32_t crc32c(const void *data, size_t numBytes, uint32_t crc)
+  {
+    const uint8_t *ptr = (const uint8_t *)data;
+    crc = ~crc;
+    crc = haveHardwareCRC()
+      ? crc32cHardware(crc,ptr,numBytes)
+      : crc32cSoftware(crc,ptr,numBytes);
+    return ~crc;
+  }
+
+  bool crc32cIsHardwareAccelerated()
+  {
+    return haveHardwareCRC();
+  }
+  
+} // ::mini
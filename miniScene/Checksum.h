@@ -0,0 +1,79 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/common.h"
+// std
+#include <streambuf>
+
+namespace mini {
+
+  /*! CRC32C (the Castagnoli polynomial, as used by iSCSI, ext4,
+      etc) of the given bytes; uses the CPU's CRC instructions (SSE4.2
+      or ARMv8 CRC) where available. 'crc' is the checksum of
+      whatever came before these bytes, so checksums can be computed
+      piece by piece: crc32c(b,crc32c(a)) is the checksum of a
+      followed by b */
+  uint32_t crc32c(const void *data, size_t numBytes, uint32_t crc = 0);
+
+  /*! whether crc32c() uses the CPU's CRC instructions on this
+      machine */
+  bool crc32cIsHardwareAccelerated();
+  
+  namespace io {
+    
+    /*! a stream buffer that passes everything written to it on to
+        another stream buffer, and computes the CRC32C of those bytes
+        along the way. Positions (ie, tellp()) are those of the
+        target buffer */
+    struct ChecksumBuffer : public std::streambuf {
+      ChecksumBuffer(std::streambuf *target) : target(target) {}
+
+      /*! checksum of all bytes written so far */
+      uint32_t checksum { 0 };
+      
+    protected:
+      std::streamsize xsputn(const char *s, std::streamsize n) override
+      {
+        const std::streamsize written = target->sputn(s,n);
+        if (written > 0)
+          checksum = crc32c(s,(size_t)written,checksum);
+        return written;
+      }
+      
+      int_type overflow(int_type c) override
+      {
+        if (traits_type::eq_int_type(c,traits_type::eof()))
+          return traits_type::not_eof(c);
+        const char ch = traits_type::to_char_type(c);
+        return xsputn(&ch,1) == 1 ? c : traits_type::eof();
+      }
+
+      int sync() override
+      { return target->pubsync(); }
+      
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                       std::ios_base::openmode which) override
+      { return target->pubseekoff(off,dir,which); }
+
+    private:
+      std::streambuf *const target;
+    };
+    
+  } // ::mini::io
+} // ::mini
@@ -0,0 +1,272 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/Compression.h"
+
+namespace mini {
+
+  namespace lz {
+    
+    /*! the byte codec: a sequence of (literals, match) pairs, each
+        starting with a token byte whose upper four bits hold the
+        number of literals, and lower four bits the match length
+        minus MIN_MATCH; a nibble of 15 means more length bytes
+        follow (each adding up to 255). Then come the literals, and
+        then a 16-bit little-endian offset back into the already
+        decoded data to copy the match from. The last sequence has
+        only literals. */
+    enum {
+      MIN_MATCH  = 4,
+      MAX_OFFSET = 0xffff,
+      HASH_BITS  = 14
+    };
+
+    inline uint32_t read32(const uint8_t *ptr)
+    {
+      uint32_t v;
+      memcpy(&v,ptr,sizeof(v));
+      return v;
+    }
+
+    inline uint32_t hash(uint32_t v)
+    { return (v * 2654435761u) >> (32-HASH_BITS); }
+    
+    inline uint8_t *writeLength(uint8_t *op, size_t length)
+    {
+      for (;length >= 255;length -= 255)
+        *op++ = 255;
+      *op++ = uint8_t(length);
+      return op;
+    }
+
+    /*! compresses 'numIn' bytes into at most 'maxOut' bytes; returns
+        the compressed size, or 0 if it did not fit */
+    size_t compress(const uint8_t *in, size_t numIn,
+                    uint8_t *out, size_t maxOut)
+    {
+      std::vector<uint32_t> table(size_t(1) << HASH_BITS,0);
+      uint8_t *op = out;
+      uint8_t *const oend = out+maxOut;
+      size_t anchor = 0;
+      size_t i = 1;
+
+      /*! appends a sequence; returns false if it does not fit */
+      auto emit = [&](size_t numLiterals, size_t offset, size_t matchLength)
+        {
+          /* worst case size of this sequence */
+          const size_t maxSize
+            = 1 + (numLiterals/255+1) + numLiterals + 2 + (matchLength/255+1);
+          if (maxSize > size_t(oend-op))
+            return false;
+          const size_t matchCode = matchLength ? matchLength-MIN_MATCH : 0;
+          *op++ = uint8_t((std::min(numLiterals,size_t(15)) << 4)
+                          | std::min(matchCode,size_t(15)));
+          if (numLiterals >= 15)
+            op = writeLength(op,numLiterals-15);
+          memcpy(op,in+anchor,numLiterals);
+          op += numLiterals;
+          if (matchLength) {
+            *op++ = uint8_t(offset);
+            *op++ = uint8_t(offset >> 8);
+            if (matchCode >= 15)
+              op = writeLength(op,matchCode-15);
+          }
+          return true;
+        };
+      
+      while (i+MIN_MATCH <= numIn) {
+        const uint32_t v   = read32(in+i);
+        uint32_t &entry    = table[hash(v)];
+        const size_t ref   = entry;
+        entry = uint32_t(i);
+        if (i-ref > MAX_OFFSET || read32(in+ref) != v) {
+          /* skip faster through data that does not compress */
+          i += 1 + ((i-anchor) >> 6);
+          continue;
+        }
+        size_t matchLength = MIN_MATCH;
+        while (i+matchLength < numIn && in[ref+matchLength] == in[i+matchLength])
+          matchLength++;
+        if (!emit(i-anchor,i-ref,matchLength))
+          return 0;
+        i += matchLength;
+        anchor = i;
+      }
+      if (!emit(numIn-anchor,0,0))
+        return 0;
+      return op-out;
+    }
+
+    /*! decompresses 'numIn' bytes into exactly 'numOut' bytes; throws
+        if the data is corrupt */
+    void decompress(const uint8_t *in, size_t numIn,
+                    uint8_t *out, size_t numOut)
+    {
+      const uint8_t *ip = in;
+      const uint8_t *const iend = in+numIn;
+      uint8_t *op = out;
+      uint8_t *const oend = out+numOut;
+      auto readLength = [&](size_t length)
+        {
+          if (length < 15)
+            return length;
+          uint8_t b;
+          do {
+            if (ip == iend)
+              throw std::runtime_error("corrupt compressed block");
+            b = *ip++;
+            length += b;
+          } while (b == 255);
+          return length;
+        };
+      
+      while (true) {
+        if (ip == iend)
+          throw std::runtime_error("corrupt compressed block");
+        const uint8_t token = *ip++;
+        const size_t numLiterals = readLength(token >> 4);
+        if (numLiterals > size_t(iend-ip) || numLiterals > size_t(oend-op))
+          throw std::runtime_error("corrupt compressed block");
+        memcpy(op,ip,numLiterals);
+        op += numLiterals;
+        ip += numLiterals;
+        if (ip == iend)
+          break;
+
+        if (iend-ip < 2)
+          throw std::runtime_error("corrupt compressed block");
+        const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+        ip += 2;
+        const size_t matchLength = readLength(token & 15) + MIN_MATCH;
+        if (offset == 0 || offset > size_t(op-out) || matchLength > size_t(oend-op))
+          throw std::runtime_error("corrupt compressed block");
+        const uint8_t *match = op-offset;
+        if (offset >= matchLength)
+          memcpy(op,match,matchLength);
+        else
+          /* overlapping match - repeats the last 'offset' bytes */
+          for (size_t i=0;i<matchLength;i++)
+            op[i] = match[i];
+        op += matchLength;
+      }
+      if (op != oend)
+        throw std::runtime_error("corrupt compressed block");
+    }
+    
+  } // ::mini::lz
+
+  inline void shuffle(const uint8_t *in, size_t numBytes, int width, uint8_t *out)
+  {
+    const size_t numWords = numBytes/width;
+    for (size_t i=0;i<numWords;i++)
+      for (int b=0;b<width;b++)
+        out[b*numWords+i] = in[i*width+b];
+  }
+  
+  inline void unshuffle(const uint8_t *in, size_t numBytes, int width, uint8_t *out)
+  {
+    const size_t numWords = numBytes/width;
+    for (size_t i=0;i<numWords;i++)
+      for (int b=0;b<width;b++)
+        out[i*width+b] = in[b*numWords+i];
+  }
+  
+  CompressedBlocks::SP CompressedBlocks::compress(const void *data,
+                                                  size_t numBytes,
+                                                  size_t elementSize)
+  {
+    CompressedBlocks::SP cb = std::make_shared<CompressedBlocks>();
+    cb->shuffleWidth
+      = (elementSize % 4 == 0) ? 4
+      : (elementSize % 2 == 0) ? 2
+      : 1;
+    const uint8_t *const src = (const uint8_t *)data;
+    const size_t blockSize = cb->blockSize;
+    const size_t numBlocks = (numBytes+blockSize-1)/blockSize;
+    std::vector<std::vector<uint8_t>> blocks(numBlocks);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t size  = std::min(blockSize,numBytes-begin);
+        const uint8_t *in = src+begin;
+        std::vector<uint8_t> shuffled;
+        if (cb->shuffleWidth > 1) {
+          shuffled.resize(size);
+          shuffle(in,size,cb->shuffleWidth,shuffled.data());
+          in = shuffled.data();
+        }
+        std::vector<uint8_t> &out = blocks[blockID];
+        out.resize(size);
+        size_t compressedSize = lz::compress(in,size,out.data(),size-1);
+        if (compressedSize)
+          out.resize(compressedSize);
+        else
+          /* store as is (and not shuffled) */
+          memcpy(out.data(),src+begin,size);
+      });
+
+    size_t compressedSize = 0;
+    for (auto &block : blocks) {
+      compressedSize += block.size();
+      cb->blockEnds.push_back(compressedSize);
+    }
+    if (compressedSize + numBlocks*sizeof(uint64_t) > numBytes - numBytes/16)
+      return {};
+    cb->bytes.resize(compressedSize);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID ? cb->blockEnds[blockID-1] : 0;
+        memcpy(cb->bytes.data()+begin,blocks[blockID].data(),blocks[blockID].size());
+      });
+    return cb;
+  }
+
+  void CompressedBlocks::decompress(void *data, size_t numBytes) const
+  {
+    if (blockSize == 0 || (shuffleWidth != 1 && shuffleWidth != 2 && shuffleWidth != 4)
+        || blockSize % shuffleWidth != 0 || numBytes % shuffleWidth != 0)
+      throw std::runtime_error("corrupt compressed array");
+    const size_t numBlocks = (numBytes+blockSize-1)/blockSize;
+    if (blockEnds.size() != numBlocks)
+      throw std::runtime_error("corrupt compressed array");
+    for (size_t blockID=0;blockID<numBlocks;blockID++) {
+      const size_t begin = blockID ? blockEnds[blockID-1] : 0;
+      const size_t size  = std::min(size_t(blockSize),numBytes-blockID*blockSize);
+      if (blockEnds[blockID] < begin || blockEnds[blockID]-begin > size)
+        throw std::runtime_error("corrupt compressed array");
+    }
+    if (numBlocks && blockEnds[numBlocks-1] != bytes.size())
+      throw std::runtime_error("corrupt compressed array");
+
+    uint8_t *const dst = (uint8_t *)data;
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t size  = std::min(size_t(blockSize),numBytes-begin);
+        const size_t compressedBegin = blockID ? blockEnds[blockID-1] : 0;
+        const size_t compressedSize  = blockEnds[blockID]-compressedBegin;
+        const uint8_t *in = bytes.data()+compressedBegin;
+        if (compressedSize == size)
+          memcpy(dst+begin,in,size);
+        else if (shuffleWidth == 1)
+          lz::decompress(in,compressedSize,dst+begin,size);
+        else {
+          std::vector<uint8_t> shuffled(size);
+          lz::decompress(in,compressedSize,shuffled.data(),size);
+          unshuffle(shuffled.data(),size,shuffleWidth,dst+begin);
+        }
+      });
+  }
+  
+} // ::mini
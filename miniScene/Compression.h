@@ -0,0 +1,59 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/Array.h"
+
+namespace mini {
+
+  /*! a large array's raw bytes, compressed in independent blocks of
+      'blockSize' bytes each, so the blocks can be (de-)compressed in
+      parallel. Each block is coded with a simple LZ77-style byte
+      codec (in the spirit of LZ4: fast to decode, modest ratio);
+      blocks that do not get smaller are stored as they are.
+
+      Before compression, each block's bytes can get 'shuffled' -
+      all first bytes of its 'shuffleWidth'-byte words, then all
+      second bytes, etc - which exposes much more redundancy in
+      arrays of floats or ints than the codec would find otherwise */
+  struct CompressedBlocks {
+    typedef std::shared_ptr<CompressedBlocks> SP;
+
+    enum {
+      BLOCK_SIZE = 256*1024,
+      /*! arrays smaller than this are not worth compressing */
+      MIN_SIZE   = 64*1024
+    };
+    
+    /*! compresses the given 'numBytes' bytes of an array of
+        'elementSize'-byte elements; returns null if that does not
+        save a reasonable amount of space */
+    static SP compress(const void *data, size_t numBytes, size_t elementSize);
+
+    /*! decompresses into the given 'numBytes' (which must be the
+        size of the original array); throws on corrupt data */
+    void decompress(void *out, size_t numBytes) const;
+    
+    uint32_t        blockSize    { BLOCK_SIZE };
+    uint32_t        shuffleWidth { 1 };
+    /*! for each block, the offset in 'bytes' where that block ends */
+    Array<uint64_t> blockEnds;
+    Array<uint8_t>  bytes;
+  };
+  
+} // ::mini
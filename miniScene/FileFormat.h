@@ -0,0 +1,998 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file miniScene/FileFormat.h describes the on-disk layout of .mini
+    files, and contains the read/write functions for the individual
+    records of such a file. As of format version 12 a file looks like
+    this:
+
+    header   : size_t magic; size_t formatFlags (see FORMAT_FLAG_*);
+    body     : one record per texture, the lights, the material
+               table, one record per mesh, one record per object, and
+               the instance table
+    TOC      : the table of contents, with offset and size of every
+               one of the above records
+    summary  : the scene's SceneInfo, followed by size_t summarySize
+               (only for TOC version 3 and newer)
+    trailer  : size_t tocOffset; size_t magic;
+
+    Records in the body can appear in any order (Scene::save always
+    writes them in the order listed above), so readers should always
+    go through the TOC. Version 11 files have no TOC, and store each
+    object's meshes inline with the object; those can only be read
+    sequentially.
+
+    Every array (see io::writeVector) is stored as its element count,
+    followed by its elements. As of version 13 an array's payload may
+    be aligned, in which case the top byte of its count holds the
+    alignment, and padding precedes the payload (see
+    io::writeArrayCount). As of version 16 large arrays may instead
+    be stored compressed, as CompressedBlocks (see
+    io::writeCompressedArray).
+
+    Each mesh record starts with an int of MESH_FLAG_*'s (which, before
+    version 14, could only be 0 or 1 - ie, null or valid). Version 15
+    added compressed indices.
+
+    As of version 17 the instance table is stored as an InstanceTable
+    (see io::writeInstanceTable); before that, each instance was an
+    int 'valid' flag followed (for valid ones) by its affine3f and
+    int object ID.
+
+    Version 18 added 16-bit indices: the (uncompressed) indices of
+    meshes whose vertex indices all fit into 16 bits get stored as
+    vec3us's rather than vec3i's.
+
+    As of TOC version 4 the TOC also stores a CRC32C of the header,
+    of every record it lists, and of the TOC block itself (see
+    TOC::forEachRecord() and io::writeTOC()).
+*/
+
+#pragma once
+
+#include "miniScene/Scene.h"
+#include "miniScene/IO.h"
+#include "miniScene/Quantization.h"
+#include "miniScene/IndexCodec.h"
+#include "miniScene/Checksum.h"
+
+namespace mini {
+
+  enum {
+    /*! version of the file format written by this library */
+    FORMAT_VERSION = 18,
+    /*! oldest version we can still read */
+    OLDEST_SUPPORTED_FORMAT_VERSION = 11
+  };
+
+  /*! flags stored in a file's header, describing how it was written */
+  enum {
+    /*! array payloads are aligned to 64 bytes (or the page size, for
+        large arrays) within the file */
+    FORMAT_FLAG_ALIGNED_ARRAYS    = 1,
+    /*! large arrays may be stored compressed */
+    FORMAT_FLAG_COMPRESSED_ARRAYS = 2
+  };
+
+  /*! flags stored at the start of each mesh record */
+  enum {
+    /*! a non-null mesh; for null meshes all flags are 0 */
+    MESH_FLAG_VALID               = 1,
+    /*! vertex positions are stored as QuantizedPositions */
+    MESH_FLAG_QUANTIZED_POSITIONS = 2,
+    /*! indices are stored as CompressedIndices */
+    MESH_FLAG_COMPRESSED_INDICES  = 4,
+    /*! indices are stored as vec3us's; never set together with
+        MESH_FLAG_COMPRESSED_INDICES */
+    MESH_FLAG_INDICES_16          = 8,
+    MESH_FLAGS_KNOWN
+    = MESH_FLAG_VALID|MESH_FLAG_QUANTIZED_POSITIONS|MESH_FLAG_COMPRESSED_INDICES
+    | MESH_FLAG_INDICES_16
+  };
+
+  inline size_t magicForVersion(int version) { return 4321000000ULL+version; }
+
+  /*! returns the format version encoded in a file magic, or -1 if
+      this magic is not one we can read */
+  inline int versionFromMagic(size_t magic)
+  {
+    if (magic < magicForVersion(OLDEST_SUPPORTED_FORMAT_VERSION) ||
+        magic > magicForVersion(FORMAT_VERSION))
+      return -1;
+    return int(magic - magicForVersion(0));
+  }
+
+  /*! the table of contents (or 'directory') of a .mini file, with the
+      location of every record in that file. Allows for random access
+      to individual textures, meshes, objects, etc, without having to
+      parse anything else of the file */
+  struct TOC {
+    /*! version of the TOC block itself; version 2 added the mesh
+        infos, version 3 the summary, version 4 the checksums */
+    enum { VERSION = 4 };
+
+    /*! a range of bytes in the file */
+    struct Chunk {
+      size_t   offset   { 0 };
+      size_t   size     { 0 };
+      /*! CRC32C of those bytes (see crc32c()); only stored in the
+          file for TOC version 4 and newer */
+      uint32_t checksum { 0 };
+    };
+
+    /*! what we know about a mesh without reading its record */
+    struct MeshInfo {
+      size_t numPrims    { 0 };
+      size_t numVertices { 0 };
+      box3f  bounds;
+      int    materialID  { -1 };
+    };
+
+    /*! reads the header, trailer, and TOC of the given file, without
+        reading anything else. Throws if this is not a file with a
+        TOC (ie, if it is of version 11) */
+    static TOC read(const std::string &fileName);
+
+    /*! calls lambda(kind,index,chunk) for the header and for every
+        record listed in this TOC, in the order their checksums are
+        stored in; 'kind' is a name like "mesh", and 'index' that
+        record's index among those of its kind (or -1 for kinds of
+        which there is only one record) */
+    template<typename Lambda>
+    void forEachRecord(const Lambda &lambda) { forEachRecord(*this,lambda); }
+    template<typename Lambda>
+    void forEachRecord(const Lambda &lambda) const { forEachRecord(*this,lambda); }
+
+    /*! format version and flags from this file's header */
+    int    formatVersion { FORMAT_VERSION };
+    size_t formatFlags   { 0 };
+    
+    /*! the file header */
+    Chunk              header;
+
+    /*! one chunk per texture, with texture ID 0 always being the
+        'null' texture */
+    std::vector<Chunk> textures;
+    Chunk              lights;
+    Chunk              materials;
+    std::vector<Chunk> meshes;
+    /*! one per mesh for TOC version 2 and newer; empty for older
+        ones */
+    std::vector<MeshInfo> meshInfos;
+    std::vector<Chunk> objects;
+    Chunk              instances;
+    /*! summary of the file's scene; for TOC version 3 and newer,
+        this gets stored right before the file trailer, so it can be
+        read without reading the TOC itself */
+    SceneInfo          summary;
+    /*! whether the chunks' checksums are valid (ie, whether this TOC
+        is of version 4 or newer) */
+    bool               hasChecksums { false };
+    /*! the TOC block itself, up to (but excluding) its own checksum;
+        only valid for a TOC read from a file */
+    Chunk              block;
+
+  private:
+    template<typename TOCRef, typename Lambda>
+    static void forEachRecord(TOCRef &toc, const Lambda &lambda)
+    {
+      lambda("header",-1,toc.header);
+      for (size_t i=0;i<toc.textures.size();i++)
+        lambda("texture",(int)i,toc.textures[i]);
+      lambda("lights",-1,toc.lights);
+      lambda("materials",-1,toc.materials);
+      for (size_t i=0;i<toc.meshes.size();i++)
+        lambda("mesh",(int)i,toc.meshes[i]);
+      for (size_t i=0;i<toc.objects.size();i++)
+        lambda("object",(int)i,toc.objects[i]);
+      lambda("instances",-1,toc.instances);
+    }
+  };
+
+  /*! computes a SceneInfo from what a writer knows about the records
+      it has written; used to compute the summary that goes into a
+      file's TOC */
+  struct SceneInfoBuilder {
+    inline void addTexture(const Texture &texture);
+    inline void setLights(const std::vector<QuadLight> &quadLights,
+                          const std::vector<DirLight>  &dirLights,
+                          const EnvMapLight::SP &envMapLight);
+    /*! adds the next object, with given meshes (-1 for null ones) */
+    void addObject(const std::vector<int> &meshIDs)
+    { objectMeshes.push_back(meshIDs); }
+    /*! adds the next instance; objectID -1 for null instances or
+        instances of null objects */
+    void addInstance(const affine3f &xfm, int objectID)
+    { instances.push_back({xfm,objectID}); }
+    inline SceneInfo finish(const std::vector<TOC::MeshInfo> &meshInfos,
+                            size_t numMaterials);
+
+    SceneInfo info;
+    std::vector<std::vector<int>>        objectMeshes;
+    std::vector<std::pair<affine3f,int>> instances;
+  };
+
+  inline void SceneInfoBuilder::addTexture(const Texture &texture)
+  {
+    info.numTextures++;
+    if (texture.format == Texture::EMBEDDED_PTEX) {
+      info.numPtexTextures++;
+      info.numPtexBytes += texture.data.size();
+    } else
+      info.numTexelBytes += texture.data.size();
+  }
+
+  inline void SceneInfoBuilder::setLights(const std::vector<QuadLight> &quadLights,
+                                          const std::vector<DirLight>  &dirLights,
+                                          const EnvMapLight::SP &envMapLight)
+  {
+    info.numQuadLights = quadLights.size();
+    info.numDirLights  = dirLights.size();
+    info.envMapSize
+      = (envMapLight && envMapLight->texture)
+      ? envMapLight->texture->size
+      : vec2i(0);
+  }
+  
+  inline SceneInfo SceneInfoBuilder::finish(const std::vector<TOC::MeshInfo> &meshInfos,
+                                            size_t numMaterials)
+  {
+    info.numMaterials    = numMaterials;
+    info.numObjects      = objectMeshes.size();
+    info.numInstances    = instances.size();
+    info.numUniqueMeshes = meshInfos.size();
+    for (auto &mesh : meshInfos) {
+      info.numUniqueTriangles += mesh.numPrims;
+      info.numUniqueVertices  += mesh.numVertices;
+    }
+    
+    struct ObjectInfo {
+      size_t numMeshes   { 0 };
+      size_t numPrims    { 0 };
+      size_t numVertices { 0 };
+      box3f  bounds;
+    };
+    std::vector<ObjectInfo> objectInfos(objectMeshes.size());
+    for (size_t objID=0;objID<objectMeshes.size();objID++) {
+      ObjectInfo &object = objectInfos[objID];
+      for (auto meshID : objectMeshes[objID]) {
+        if (meshID < 0) continue;
+        const TOC::MeshInfo &mesh = meshInfos[meshID];
+        object.numMeshes++;
+        object.numPrims    += mesh.numPrims;
+        object.numVertices += mesh.numVertices;
+        object.bounds.extend(mesh.bounds);
+      }
+    }
+
+    info.worldBounds = box3f();
+    for (auto &inst : instances) {
+      if (inst.second < 0) continue;
+      const ObjectInfo &object = objectInfos[inst.second];
+      info.numActualMeshes    += object.numMeshes;
+      info.numActualTriangles += object.numPrims;
+      info.numActualVertices  += object.numVertices;
+      if (!object.bounds.empty())
+        info.worldBounds.extend(xfmBox(inst.first,object.bounds));
+    }
+    return info;
+  }
+
+  /*! how a mesh's arrays get stored in a file; null members mean
+      the respective array gets stored as it is */
+  struct MeshEncoding {
+    QuantizedPositions::SP positions;
+    CompressedIndices::SP  indices;
+  };
+  
+  /*! decides, according to the given options, how to encode the
+      given (resident) mesh, and does so */
+  inline MeshEncoding encodeForSave(const Mesh &mesh,
+                                    const SaveOptions &options)
+  {
+    MeshEncoding encoding;
+    if (options.quantizePositionBits && !mesh.vertices.empty()) {
+      encoding.positions
+        = QuantizedPositions::encode(mesh.vertices,options.quantizePositionBits);
+      if (options.maxQuantizationError > 0.f &&
+          encoding.positions->maxError > options.maxQuantizationError)
+        encoding.positions = nullptr;
+    }
+    const size_t numTriangles = mesh.getNumPrims();
+    if (options.compressIndices && numTriangles) {
+      if (mesh.indices16.empty())
+        encoding.indices = CompressedIndices::encode(mesh.indices);
+      else {
+        Mesh wide;
+        wide.indices16 = mesh.indices16;
+        wide.expandIndices();
+        encoding.indices = CompressedIndices::encode(wide.indices);
+      }
+      /* meshes with poor locality may not compress at all, and
+         small meshes may be stored smaller with 16-bit indices (see
+         io::writeMesh()) */
+      const size_t rawSize
+        = numTriangles*(mesh.canCompactIndices() ? sizeof(vec3us) : sizeof(vec3i));
+      if (encoding.indices->sizeInBytes() >= rawSize)
+        encoding.indices = nullptr;
+    }
+    return encoding;
+  }
+  
+  namespace io {
+
+    inline void seek(std::istream &in, size_t offset)
+    {
+      if ((size_t)in.tellg() != offset)
+        in.seekg(offset);
+    }
+
+    inline void seek(MappedReader &in, size_t offset)
+    { in.offset = offset; }
+
+    inline size_t tell(std::ostream &out)
+    { return (size_t)out.tellp(); }
+
+    inline size_t tell(std::istream &in)
+    { return (size_t)in.tellg(); }
+
+    inline size_t tell(const MappedReader &in)
+    { return in.offset; }
+
+    /*! writes one record by calling write(out), and sets 'chunk' to
+        where in the file that record ended up, and to the checksum
+        of its bytes */
+    template<typename Lambda>
+    inline void writeRecord(std::ostream &out, TOC::Chunk &chunk,
+                            const Lambda &write)
+    {
+      ChecksumBuffer checksummer(out.rdbuf());
+      std::ostream recordOut(&checksummer);
+      /* also copies the stream's alignArrays() etc */
+      recordOut.copyfmt(out);
+      chunk.offset = tell(recordOut);
+      write(recordOut);
+      chunk.size     = tell(recordOut) - chunk.offset;
+      chunk.checksum = checksummer.checksum;
+      if (!recordOut.good())
+        out.setstate(std::ios::badbit);
+    }
+
+    /*! computes the CRC32C of the given range of the input */
+    inline uint32_t checksumRange(std::istream &in, const TOC::Chunk &chunk)
+    {
+      /* large enough for bulk readers to keep many reads in flight */
+      const size_t pieceSize = size_t(8)<<20;
+      std::vector<char> piece(std::min(chunk.size,pieceSize));
+      seek(in,chunk.offset);
+      uint32_t crc = 0;
+      for (size_t begin=0;begin<chunk.size;begin+=pieceSize) {
+        const size_t numBytes = std::min(pieceSize,chunk.size-begin);
+        readArray(in,piece.data(),numBytes);
+        crc = crc32c(piece.data(),numBytes,crc);
+      }
+      return crc;
+    }
+
+    inline uint32_t checksumRange(MappedReader &in, const TOC::Chunk &chunk)
+    {
+      seek(in,chunk.offset);
+      return crc32c(in.consume(chunk.size),chunk.size);
+    }
+    
+    inline void writeChunk(std::ostream &out, const TOC::Chunk &chunk)
+    {
+      writeElement(out,chunk.offset);
+      writeElement(out,chunk.size);
+    }
+
+    template<typename In>
+    inline void readChunk(In &in, TOC::Chunk &chunk)
+    {
+      readElement(in,chunk.offset);
+      readElement(in,chunk.size);
+    }
+
+    inline void writeChunks(std::ostream &out, const std::vector<TOC::Chunk> &chunks)
+    {
+      writeElement(out,chunks.size());
+      for (auto &chunk : chunks)
+        writeChunk(out,chunk);
+    }
+
+    template<typename In>
+    inline void readChunks(In &in, std::vector<TOC::Chunk> &chunks)
+    {
+      chunks.resize(readElement<size_t>(in));
+      for (auto &chunk : chunks)
+        readChunk(in,chunk);
+    }
+
+    inline void writeMeshInfos(std::ostream &out, const std::vector<TOC::MeshInfo> &infos)
+    {
+      writeElement(out,infos.size());
+      for (auto &info : infos) {
+        writeElement(out,info.numPrims);
+        writeElement(out,info.numVertices);
+        writeElement(out,info.bounds);
+        writeElement(out,info.materialID);
+      }
+    }
+
+    template<typename In>
+    inline void readMeshInfos(In &in, std::vector<TOC::MeshInfo> &infos)
+    {
+      infos.resize(readElement<size_t>(in));
+      for (auto &info : infos) {
+        readElement(in,info.numPrims);
+        readElement(in,info.numVertices);
+        readElement(in,info.bounds);
+        readElement(in,info.materialID);
+      }
+    }
+
+    inline void writeSceneInfo(std::ostream &out, const SceneInfo &info)
+    {
+      writeElement(out,info.numInstances);
+      writeElement(out,info.numObjects);
+      writeElement(out,info.numUniqueMeshes);
+      writeElement(out,info.numUniqueTriangles);
+      writeElement(out,info.numUniqueVertices);
+      writeElement(out,info.numActualMeshes);
+      writeElement(out,info.numActualTriangles);
+      writeElement(out,info.numActualVertices);
+      writeElement(out,info.numTextures);
+      writeElement(out,info.numPtexTextures);
+      writeElement(out,info.numPtexBytes);
+      writeElement(out,info.numTexelBytes);
+      writeElement(out,info.numMaterials);
+      writeElement(out,info.numQuadLights);
+      writeElement(out,info.numDirLights);
+      writeElement(out,info.envMapSize);
+      writeElement(out,info.worldBounds);
+    }
+
+    template<typename In>
+    inline void readSceneInfo(In &in, SceneInfo &info)
+    {
+      readElement(in,info.numInstances);
+      readElement(in,info.numObjects);
+      readElement(in,info.numUniqueMeshes);
+      readElement(in,info.numUniqueTriangles);
+      readElement(in,info.numUniqueVertices);
+      readElement(in,info.numActualMeshes);
+      readElement(in,info.numActualTriangles);
+      readElement(in,info.numActualVertices);
+      readElement(in,info.numTextures);
+      readElement(in,info.numPtexTextures);
+      readElement(in,info.numPtexBytes);
+      readElement(in,info.numTexelBytes);
+      readElement(in,info.numMaterials);
+      readElement(in,info.numQuadLights);
+      readElement(in,info.numDirLights);
+      readElement(in,info.envMapSize);
+      readElement(in,info.worldBounds);
+    }
+    
+    /*! writes the TOC block, followed by the summary block and the
+        file trailer. The TOC block ends with the checksums of all
+        records (as size_t count plus that many uint32_t's, in the
+        order of TOC::forEachRecord()), followed by the checksum of
+        the TOC block up to that point. The summary block is the
+        summary itself, followed by its size in bytes; so it can be
+        found from the end of the file, and later versions can
+        append to it */
+    inline void writeTOC(std::ostream &out, const TOC &toc)
+    {
+      TOC::Chunk block;
+      writeRecord(out,block,[&](std::ostream &out){
+          writeElement(out,size_t(TOC::VERSION));
+          writeChunks(out,toc.textures);
+          writeChunk(out,toc.lights);
+          writeChunk(out,toc.materials);
+          writeChunks(out,toc.meshes);
+          writeMeshInfos(out,toc.meshInfos);
+          writeChunks(out,toc.objects);
+          writeChunk(out,toc.instances);
+
+          std::vector<uint32_t> checksums;
+          toc.forEachRecord([&](const char *, int, const TOC::Chunk &chunk){
+              checksums.push_back(chunk.checksum);
+            });
+          writeElement(out,checksums.size());
+          writeArray(out,checksums.data(),checksums.size());
+        });
+      writeElement(out,block.checksum);
+      const size_t tocOffset = block.offset;
+
+      size_t summaryOffset = tell(out);
+      writeSceneInfo(out,toc.summary);
+      writeElement(out,tell(out)-summaryOffset);
+      
+      writeElement(out,tocOffset);
+      writeElement(out,magicForVersion(toc.formatVersion));
+    }
+
+    /*! reads header, trailer, and TOC from the given input */
+    template<typename In>
+    inline void readTOC(In &in, size_t fileSize, TOC &toc)
+    {
+      if (fileSize < 4*sizeof(size_t))
+        throw std::runtime_error("not a valid 'mini' file (too small)");
+      seek(in,0);
+      toc.formatVersion = versionFromMagic(readElement<size_t>(in));
+      if (toc.formatVersion < 0)
+        throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic) - cannot load");
+      if (toc.formatVersion < 12)
+        throw std::runtime_error("'mini' file of version "+std::to_string(toc.formatVersion)
+                                 +" does not have a table of contents");
+      readElement(in,toc.formatFlags);
+
+      seek(in,fileSize-2*sizeof(size_t));
+      size_t tocOffset = readElement<size_t>(in);
+      size_t magicAtEnd = readElement<size_t>(in);
+      if (versionFromMagic(magicAtEnd) != toc.formatVersion)
+        throw std::runtime_error("incomplete or incompatible 'mini' file - cannot load");
+      if (tocOffset >= fileSize)
+        throw std::runtime_error("corrupt 'mini' file (invalid TOC offset)");
+
+      seek(in,tocOffset);
+      size_t tocVersion = readElement<size_t>(in);
+      if (tocVersion < 1 || tocVersion > TOC::VERSION)
+        throw std::runtime_error("unsupported TOC version in 'mini' file");
+      readChunks(in,toc.textures);
+      readChunk(in,toc.lights);
+      readChunk(in,toc.materials);
+      readChunks(in,toc.meshes);
+      if (tocVersion >= 2)
+        readMeshInfos(in,toc.meshInfos);
+      readChunks(in,toc.objects);
+      readChunk(in,toc.instances);
+      toc.header.offset = 0;
+      toc.header.size   = 2*sizeof(size_t);
+      toc.hasChecksums  = (tocVersion >= 4);
+      if (toc.hasChecksums) {
+        size_t numChecksums = 0;
+        toc.forEachRecord([&](const char *, int, const TOC::Chunk &){
+            numChecksums++;
+          });
+        if (readElement<size_t>(in) != numChecksums)
+          throw std::runtime_error("corrupt 'mini' file (invalid number of checksums)");
+        toc.forEachRecord([&](const char *, int, TOC::Chunk &chunk){
+            readElement(in,chunk.checksum);
+          });
+        toc.block.offset = tocOffset;
+        toc.block.size   = tell(in) - tocOffset;
+        readElement(in,toc.block.checksum);
+      }
+      if (tocVersion >= 3)
+        readSceneInfo(in,toc.summary);
+    }
+
+    /*! reads only the summary block of the given input; returns false
+        if the file doesn't have one (ie, if it's too old) */
+    template<typename In>
+    inline bool readSummary(In &in, size_t fileSize, SceneInfo &summary)
+    {
+      if (fileSize < 4*sizeof(size_t))
+        throw std::runtime_error("not a valid 'mini' file (too small)");
+      seek(in,0);
+      const int formatVersion = versionFromMagic(readElement<size_t>(in));
+      if (formatVersion < 0)
+        throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic)");
+      if (formatVersion < 12)
+        return false;
+      
+      seek(in,fileSize-2*sizeof(size_t));
+      size_t tocOffset = readElement<size_t>(in);
+      if (versionFromMagic(readElement<size_t>(in)) != formatVersion)
+        throw std::runtime_error("incomplete or incompatible 'mini' file");
+      if (tocOffset >= fileSize)
+        throw std::runtime_error("corrupt 'mini' file (invalid TOC offset)");
+      seek(in,tocOffset);
+      if (readElement<size_t>(in) < 3)
+        return false;
+
+      seek(in,fileSize-3*sizeof(size_t));
+      size_t summarySize = readElement<size_t>(in);
+      if (summarySize > fileSize-tocOffset)
+        throw std::runtime_error("corrupt 'mini' file (invalid summary size)");
+      seek(in,fileSize-3*sizeof(size_t)-summarySize);
+      readSceneInfo(in,summary);
+      return true;
+    }
+
+    // ------------------------------------------------------------------
+    // textures
+    // ------------------------------------------------------------------
+
+    inline void writeTextureData(std::ostream &out, const Texture::SP &tex)
+    {
+      writeElement(out,tex->size);
+      writeElement(out,tex->format);
+      writeVector(out,tex->data);
+    }
+
+    template<typename In>
+    inline void readTextureData(In &in, Texture::SP tex)
+    {
+      readElement(in,tex->size);
+      readElement(in,tex->format);
+      readVector(in,tex->data);
+    }
+
+    /*! writes a texture record; 'tex' may be null */
+    inline void writeTexture(std::ostream &out, const Texture::SP &tex)
+    {
+      if (!tex) {
+        writeElement(out,int(0));
+      } else {
+        writeElement(out,int(1));
+        writeTextureData(out,tex);
+      }
+    }
+
+    template<typename In>
+    inline Texture::SP readTexture(In &in)
+    {
+      if (!readElement<int>(in))
+        return {};
+      Texture::SP tex = std::make_shared<Texture>();
+      readTextureData(in,tex);
+      return tex;
+    }
+
+    // ------------------------------------------------------------------
+    // lights
+    // ------------------------------------------------------------------
+
+    inline void writeLights(std::ostream &out, const Scene *scene)
+    {
+      writeVector(out,scene->quadLights);
+      writeVector(out,scene->dirLights);
+      if (scene->envMapLight) {
+        writeElement(out,int(1));
+        writeElement(out,scene->envMapLight->transform);
+        assert(scene->envMapLight->texture);
+        writeTextureData(out,scene->envMapLight->texture);
+      } else
+        writeElement(out,int(0));
+    }
+
+    template<typename In>
+    inline void readLights(In &in, Scene *scene)
+    {
+      readVector(in,scene->quadLights);
+      readVector(in,scene->dirLights);
+      const int hasEnvMap = readElement<int>(in);
+      if (hasEnvMap) {
+        scene->envMapLight = std::make_shared<EnvMapLight>();
+        readElement(in,scene->envMapLight->transform);
+        scene->envMapLight->texture = std::make_shared<Texture>();
+        readTextureData(in,scene->envMapLight->texture);
+      }
+    }
+
+    // ------------------------------------------------------------------
+    // materials
+    // ------------------------------------------------------------------
+
+    /*! writes one material, with the given IDs for its textures */
+    inline void writeMaterial(std::ostream &out, const Material::SP &mat,
+                              int colorTextureID, int alphaTextureID)
+    {
+      writeElement(out,mat->emission);
+      writeElement(out,mat->baseColor);
+      writeElement(out,mat->metallic);
+      writeElement(out,mat->roughness);
+      writeElement(out,mat->transmission);
+      writeElement(out,mat->ior);
+      writeElement(out,colorTextureID);
+      writeElement(out,alphaTextureID);
+    }
+
+    /*! reads one material, returning the IDs of its textures
+        (without resolving them); if 'arena' is given, the material
+        gets created in that */
+    template<typename In>
+    inline Material::SP readMaterial(In &in, int &colorTextureID, int &alphaTextureID,
+                                     Arena *arena = nullptr)
+    {
+      Material::SP mat = arena ? arena->make<Material>() : std::make_shared<Material>();
+      readElement(in,mat->emission);
+      readElement(in,mat->baseColor);
+      readElement(in,mat->metallic);
+      readElement(in,mat->roughness);
+      readElement(in,mat->transmission);
+      readElement(in,mat->ior);
+      readElement(in,colorTextureID);
+      readElement(in,alphaTextureID);
+      return mat;
+    }
+
+    template<typename In>
+    inline Material::SP readMaterial(In &in, const std::vector<Texture::SP> &textures,
+                                     Arena *arena = nullptr)
+    {
+      int colorTextureID, alphaTextureID;
+      Material::SP mat = readMaterial(in,colorTextureID,alphaTextureID,arena);
+      if (colorTextureID < 0 || colorTextureID >= (int)textures.size() ||
+          alphaTextureID < 0 || alphaTextureID >= (int)textures.size())
+        throw std::runtime_error("invalid texture ID in 'mini' file");
+      mat->colorTexture = textures[colorTextureID];
+      mat->alphaTexture = textures[alphaTextureID];
+      return mat;
+    }
+
+    // ------------------------------------------------------------------
+    // meshes
+    // ------------------------------------------------------------------
+
+    inline void writeQuantizedPositions(std::ostream &out, const QuantizedPositions &qp)
+    {
+      writeElement(out,qp.bits);
+      writeElement(out,qp.lower);
+      writeElement(out,qp.scale);
+      writeElement(out,qp.maxError);
+      if (qp.bits <= QuantizedPositions::MAX_NARROW_BITS)
+        writeVector(out,qp.narrow);
+      else
+        writeVector(out,qp.wide);
+    }
+
+    template<typename In>
+    inline void readQuantizedPositions(In &in, QuantizedPositions &qp)
+    {
+      readElement(in,qp.bits);
+      if (qp.bits < 1 || qp.bits > QuantizedPositions::MAX_BITS)
+        throw std::runtime_error("invalid quantized positions in 'mini' file");
+      readElement(in,qp.lower);
+      readElement(in,qp.scale);
+      readElement(in,qp.maxError);
+      if (qp.bits <= QuantizedPositions::MAX_NARROW_BITS) {
+        readVector(in,qp.narrow);
+        if (qp.narrow.size() % 3)
+          throw std::runtime_error("invalid quantized positions in 'mini' file");
+      } else
+        readVector(in,qp.wide);
+    }
+    
+    inline void writeCompressedIndices(std::ostream &out, const CompressedIndices &ci)
+    {
+      writeElement(out,ci.numTriangles);
+      writeVector(out,ci.chunkEnds);
+      writeVector(out,ci.bytes);
+    }
+
+    template<typename In>
+    inline void readCompressedIndices(In &in, CompressedIndices &ci)
+    {
+      readElement(in,ci.numTriangles);
+      readVector(in,ci.chunkEnds);
+      readVector(in,ci.bytes);
+    }
+    
+    /*! writes a mesh's triangles as vec3us's; all its vertex indices
+        have to fit into 16 bits */
+    inline void writeIndices16(std::ostream &out, const Mesh &mesh)
+    {
+      if (!mesh.indices16.empty()) {
+        writeVector(out,mesh.indices16);
+        return;
+      }
+      Array<vec3us> indices16;
+      indices16.resize(mesh.indices.size());
+      for (size_t i=0;i<indices16.size();i++)
+        indices16[i] = vec3us(mesh.indices[i]);
+      writeVector(out,indices16);
+    }
+    
+    /*! writes a (non-null) mesh record, with given material ID, and
+        with its arrays encoded as specified. Indices that don't get
+        compressed get stored with 16 bits each if they all fit */
+    inline void writeMesh(std::ostream &out, const Mesh::SP &mesh, int matID,
+                          const MeshEncoding &encoding = MeshEncoding())
+    {
+      const bool indices16 = !encoding.indices && mesh->canCompactIndices();
+      writeElement(out,int(MESH_FLAG_VALID
+                           | (encoding.positions ? MESH_FLAG_QUANTIZED_POSITIONS : 0)
+                           | (encoding.indices ? MESH_FLAG_COMPRESSED_INDICES : 0)
+                           | (indices16 ? MESH_FLAG_INDICES_16 : 0)));
+      if (encoding.indices)
+        writeCompressedIndices(out,*encoding.indices);
+      else if (indices16)
+        writeIndices16(out,*mesh);
+      else
+        writeVector(out,mesh->indices);
+      if (encoding.positions)
+        writeQuantizedPositions(out,*encoding.positions);
+      else
+        writeVector(out,mesh->vertices);
+      writeVector(out,mesh->normals);
+      writeVector(out,mesh->texcoords);
+      writeElement(out,matID);
+    }
+
+    /*! reads the arrays of a (non-null) mesh record, ie, everything
+        after its flags and before its material ID. With an arena,
+        arrays stored as they are get read into that arena (decoded
+        ones do not). With 'compactIndices' the triangles end up in
+        Mesh::indices16 if they fit, else always in Mesh::indices
+        (see LoadOptions::compactIndices) */
+    template<typename In>
+    inline void readMeshArrays(In &in, Mesh *mesh, int flags, Arena *arena = nullptr,
+                               bool compactIndices = false)
+    {
+      if (flags & ~MESH_FLAGS_KNOWN)
+        throw std::runtime_error("mesh in 'mini' file uses unknown encoding");
+      if ((flags & MESH_FLAG_COMPRESSED_INDICES) && (flags & MESH_FLAG_INDICES_16))
+        throw std::runtime_error("mesh in 'mini' file has invalid flags");
+      if (flags & MESH_FLAG_COMPRESSED_INDICES) {
+        CompressedIndices indices;
+        readCompressedIndices(in,indices);
+        indices.decode(mesh->indices);
+        if (compactIndices)
+          mesh->compactIndices();
+      } else if (flags & MESH_FLAG_INDICES_16) {
+        if (compactIndices)
+          readVector(in,mesh->indices16,arena);
+        else {
+          Array<vec3us> indices16;
+          readVector(in,indices16);
+          if (arena)
+            mesh->indices = arena->allocateArray<vec3i>(indices16.size());
+          else
+            mesh->indices.resize(indices16.size());
+          for (size_t i=0;i<indices16.size();i++)
+            mesh->indices[i] = vec3i(indices16[i]);
+        }
+      } else
+        readVector(in,mesh->indices,arena);
+      if (flags & MESH_FLAG_QUANTIZED_POSITIONS) {
+        QuantizedPositions positions;
+        readQuantizedPositions(in,positions);
+        positions.decode(mesh->vertices);
+      } else
+        readVector(in,mesh->vertices,arena);
+      readVector(in,mesh->normals,arena);
+      readVector(in,mesh->texcoords,arena);
+    }
+    
+    /*! reads a mesh record; returns null if that record describes a
+        null mesh. 'bounds', if given, are the mesh's bounds as stored
+        in the file's TOC; these become the mesh's cached bounds -
+        unless its positions are quantized, in which case the decoded
+        positions may lie (very slightly) outside of them. If 'arena'
+        is given, the mesh (and its arrays) get created in that. See
+        readMeshArrays() for 'compactIndices' */
+    template<typename In>
+    inline Mesh::SP readMesh(In &in, const std::vector<Material::SP> &materials,
+                             const box3f *bounds = nullptr, Arena *arena = nullptr,
+                             bool compactIndices = false)
+    {
+      int flags = readElement<int>(in);
+      if (!(flags & MESH_FLAG_VALID))
+        return {};
+      Mesh::SP mesh = arena ? arena->make<Mesh>() : std::make_shared<Mesh>();
+      readMeshArrays(in,mesh.get(),flags,arena,compactIndices);
+      if (bounds && !(flags & MESH_FLAG_QUANTIZED_POSITIONS))
+        mesh->cachedBounds.set(*bounds);
+      int matID = readElement<int>(in);
+      if (matID < 0 || matID >= (int)materials.size())
+        throw std::runtime_error("invalid material ID in 'mini' file");
+      mesh->material = materials[matID];
+      return mesh;
+    }
+
+    // ------------------------------------------------------------------
+    // objects
+    // ------------------------------------------------------------------
+
+    /*! writes an object record, as the list of its meshes' IDs (-1
+        for null meshes) */
+    inline void writeObject(std::ostream &out, const std::vector<int> &meshIDs)
+    {
+      writeElement(out,meshIDs.size());
+      writeArray(out,meshIDs.data(),meshIDs.size());
+    }
+
+    /*! reads an object record; if 'arena' is given, the object gets
+        created in that */
+    template<typename In>
+    inline Object::SP readObject(In &in, const std::vector<Mesh::SP> &meshes,
+                                 Arena *arena = nullptr)
+    {
+      Object::SP object = arena ? arena->make<Object>() : std::make_shared<Object>();
+      std::vector<int> meshIDs;
+      readVector(in,meshIDs);
+      for (auto meshID : meshIDs) {
+        if (meshID >= (int)meshes.size())
+          throw std::runtime_error("invalid mesh ID in 'mini' file");
+        if (meshID < 0 || !meshes[meshID])
+          // same as for version 11: null meshes get dropped
+          continue;
+        object->meshes.push_back(meshes[meshID]);
+      }
+      return object;
+    }
+
+    // ------------------------------------------------------------------
+    // instances
+    // ------------------------------------------------------------------
+
+    /*! writes the instance table (version 17 and newer) */
+    inline void writeInstanceTable(std::ostream &out, const InstanceTable &table)
+    {
+      writeElement(out,table.size());
+      writeVector(out,table.transforms);
+      writeVector(out,table.objectIDs);
+      writeVector(out,table.valid);
+    }
+
+    /*! reads the instance table of a file of given version, whose
+        objects IDs must be less than 'numObjects'. Leaves the
+        table's 'objects' alone */
+    template<typename In>
+    inline void readInstanceTable(In &in, int formatVersion, size_t numObjects,
+                                  InstanceTable &table)
+    {
+      const size_t numInstances = readElement<size_t>(in);
+      if (formatVersion < 17) {
+        table.transforms.clear();
+        table.objectIDs.clear();
+        table.valid.clear();
+        for (size_t instID=0;instID<numInstances;instID++) {
+          if (!readElement<int>(in)) {
+            table.push_back(affine3f(),InstanceTable::NO_OBJECT,false);
+            continue;
+          }
+          affine3f xfm;
+          readElement(in,xfm);
+          int objectID = readElement<int>(in);
+          table.push_back(xfm,objectID < 0 ? (uint32_t)InstanceTable::NO_OBJECT : (uint32_t)objectID);
+        }
+      } else {
+        readVector(in,table.transforms);
+        readVector(in,table.objectIDs);
+        readVector(in,table.valid);
+        if (table.transforms.size() != numInstances ||
+            table.objectIDs.size() != numInstances ||
+            table.valid.size() != (numInstances+63)/64)
+          throw std::runtime_error("corrupt instance table in 'mini' file");
+      }
+      for (auto objectID : table.objectIDs)
+        if (objectID >= numObjects && objectID != InstanceTable::NO_OBJECT)
+          throw std::runtime_error("invalid object ID in 'mini' file");
+    }
+    
+    /*! reads one instance of a version 11 file */
+    template<typename In>
+    inline Instance::SP readInstance(In &in, const std::vector<Object::SP> &objects)
+    {
+      int isValid = readElement<int>(in);
+      if (!isValid)
+        return {};
+      Instance::SP inst = std::make_shared<Instance>();
+      readElement(in,inst->xfm);
+      int objID = readElement<int>(in);
+      if (objID >= (int)objects.size())
+        throw std::runtime_error("invalid object ID in 'mini' file");
+      inst->object = objID < 0 ? Object::SP() : objects[objID];
+      return inst;
+    }
+
+  } // ::mini::io
+} // ::mini
@@ -0,0 +1,370 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/FlatScene.h"
+#include "miniScene/Serialized.h"
+#include "miniScene/MappedFile.h"
+#include <fstream>
+
+namespace mini {
+
+  /*! first bytes of a flat scene file ("miniFlat") */
+  static const uint64_t FLAT_MAGIC   = 0x74616c46696e696dull;
+  static const uint32_t FLAT_VERSION = 1;
+  /*! file offset every array of a flat scene file starts at a
+      multiple of */
+  static const size_t   FLAT_ARRAY_ALIGNMENT = 64;
+  static const int      NUM_FLAT_ARRAYS = 14;
+  
+  /*! where in a flat scene file one of its arrays is */
+  struct FlatArrayEntry {
+    uint64_t offset;
+    uint64_t count;
+    uint64_t elementSize;
+  };
+
+  /*! what a flat scene file starts with; the arrays follow */
+  struct FlatFileHeader {
+    uint64_t       magic;
+    uint32_t       version;
+    uint32_t       numArrays;
+    FlatArrayEntry arrays[NUM_FLAT_ARRAYS];
+    int32_t        envMapTextureID;
+    int32_t        padding;
+    affine3f       envMapTransform;
+  };
+
+  /*! copies a mesh's triangles (of either index width, see
+      Mesh::withIndices()) into the flat scene's (32-bit) indices */
+  struct CopyIndices {
+    template<typename Index>
+    void operator()(const Index *triangles, size_t numTriangles) const
+    {
+      for (size_t i=0;i<numTriangles;i++)
+        out[i] = vec3i(triangles[i]);
+    }
+    vec3i *out;
+  };
+  
+  /*! calls op(array) for each of a flat scene's arrays, in the order
+      they are stored in */
+  template<typename Flat, typename Op>
+  static void forEachArray(Flat &flat, Op &op)
+  {
+    op(flat.vertices);
+    op(flat.normals);
+    op(flat.texcoords);
+    op(flat.indices);
+    op(flat.meshes);
+    op(flat.objectMeshes);
+    op(flat.objects);
+    op(flat.transforms);
+    op(flat.objectIDs);
+    op(flat.materials);
+    op(flat.textures);
+    op(flat.texels);
+    op(flat.quadLights);
+    op(flat.dirLights);
+  }
+
+  static size_t alignUp(size_t offset)
+  {
+    return (offset+FLAT_ARRAY_ALIGNMENT-1)/FLAT_ARRAY_ALIGNMENT*FLAT_ARRAY_ALIGNMENT;
+  }
+  
+  /*! assigns each array its place in the file */
+  struct FlatLayout {
+    template<typename T>
+    void operator()(const Array<T> &array)
+    {
+      FlatArrayEntry &entry = header.arrays[numArrays++];
+      offset = alignUp(offset);
+      entry.offset      = offset;
+      entry.count       = array.size();
+      entry.elementSize = sizeof(T);
+      offset += array.size()*sizeof(T);
+    }
+    FlatFileHeader &header;
+    size_t offset;
+    int    numArrays;
+  };
+
+  /*! writes each array to where FlatLayout put it */
+  struct FlatWriter {
+    template<typename T>
+    void operator()(const Array<T> &array)
+    {
+      static const char zeroes[FLAT_ARRAY_ALIGNMENT] = {};
+      const FlatArrayEntry &entry = header.arrays[numArrays++];
+      out.write(zeroes,entry.offset-offset);
+      out.write((const char *)array.data(),array.size()*sizeof(T));
+      offset = entry.offset+array.size()*sizeof(T);
+    }
+    const FlatFileHeader &header;
+    std::ofstream &out;
+    size_t offset;
+    int    numArrays;
+  };
+
+  /*! makes each array a view of its part of the mapped file */
+  struct FlatViewer {
+    template<typename T>
+    void operator()(Array<T> &array)
+    {
+      const FlatArrayEntry &entry = header.arrays[numArrays++];
+      if (entry.elementSize != sizeof(T) ||
+          entry.offset % FLAT_ARRAY_ALIGNMENT != 0 ||
+          entry.offset > file->size ||
+          entry.count > (file->size-entry.offset)/sizeof(T))
+        throw std::runtime_error("corrupt flat scene file");
+      if (entry.count)
+        array = Array<T>::view((T*)(file->data+entry.offset),entry.count,file);
+    }
+    const FlatFileHeader &header;
+    MappedFile::SP file;
+    int    numArrays;
+  };
+  
+  FlatScene::SP FlatScene::compile(const Scene *scene)
+  {
+    FlatScene::SP flat = std::make_shared<FlatScene>();
+    SerializedScene serialized(scene);
+
+    // ------------------------------------------------------------------
+    // textures: ID 0 of the serialized ones is the null texture, which
+    // doesn't get stored; the env-map's texture (if any) goes last
+    // ------------------------------------------------------------------
+    std::vector<Texture::SP> textures(serialized.textures.list.begin()+1,
+                                      serialized.textures.list.end());
+    if (scene->envMapLight && scene->envMapLight->texture) {
+      flat->envMapTextureID = (int32_t)textures.size();
+      flat->envMapTransform = scene->envMapLight->transform;
+      textures.push_back(scene->envMapLight->texture);
+    }
+    flat->textures.resize(textures.size());
+    size_t numTexels = 0;
+    for (size_t texID=0;texID<textures.size();texID++) {
+      FlatTexture &texture = flat->textures[texID];
+      texture.format    = textures[texID]->format;
+      texture.size      = textures[texID]->size;
+      texture.firstByte = numTexels;
+      texture.numBytes  = textures[texID]->data.size();
+      numTexels += (texture.numBytes+15)/16*16;
+    }
+    flat->texels.resize(numTexels);
+    parallel_for(textures.size(),[&](size_t texID){
+        const Texture::SP &texture = textures[texID];
+        if (!texture->data.empty())
+          memcpy(flat->texels.data()+flat->textures[texID].firstByte,
+                 texture->data.data(),texture->data.size());
+      });
+
+    // ------------------------------------------------------------------
+    // materials
+    // ------------------------------------------------------------------
+    auto textureID = [&](const Texture::SP &texture) {
+      return texture ? serialized.getID(texture)-1 : -1;
+    };
+    flat->materials.resize(serialized.materials.size());
+    for (size_t matID=0;matID<serialized.materials.size();matID++) {
+      const Material &material = *serialized.materials[(int)matID];
+      FlatMaterial &flatMaterial = flat->materials[matID];
+      flatMaterial.emission       = material.emission;
+      flatMaterial.baseColor      = material.baseColor;
+      flatMaterial.metallic       = material.metallic;
+      flatMaterial.roughness      = material.roughness;
+      flatMaterial.transmission   = material.transmission;
+      flatMaterial.ior            = material.ior;
+      flatMaterial.colorTextureID = textureID(material.colorTexture);
+      flatMaterial.alphaTextureID = textureID(material.alphaTexture);
+    }
+    
+    // ------------------------------------------------------------------
+    // meshes: ranges first, then the copying, in parallel
+    // ------------------------------------------------------------------
+    const size_t numMeshes = serialized.meshes.size();
+    flat->meshes.resize(numMeshes);
+    FlatMesh total = {};
+    for (size_t meshID=0;meshID<numMeshes;meshID++) {
+      const Mesh::SP &mesh = serialized.meshes[(int)meshID];
+      Mesh::Pin pin(mesh.get());
+      FlatMesh &flatMesh = flat->meshes[meshID];
+      flatMesh.firstVertex   = total.numVertices;
+      flatMesh.numVertices   = mesh->vertices.size();
+      flatMesh.firstNormal   = total.numNormals;
+      flatMesh.numNormals    = mesh->normals.size();
+      flatMesh.firstTexcoord = total.numTexcoords;
+      flatMesh.numTexcoords  = mesh->texcoords.size();
+      flatMesh.firstTriangle = total.numTriangles;
+      flatMesh.numTriangles  = mesh->getNumPrims();
+      flatMesh.materialID    = serialized.getID(mesh->material);
+      total.numVertices  += flatMesh.numVertices;
+      total.numNormals   += flatMesh.numNormals;
+      total.numTexcoords += flatMesh.numTexcoords;
+      total.numTriangles += flatMesh.numTriangles;
+    }
+    flat->vertices.resize(total.numVertices);
+    flat->normals.resize(total.numNormals);
+    flat->texcoords.resize(total.numTexcoords);
+    flat->indices.resize(total.numTriangles);
+    parallel_for(numMeshes,[&](size_t meshID){
+        const Mesh::SP &mesh = serialized.meshes[(int)meshID];
+        Mesh::Pin pin(mesh.get());
+        const FlatMesh &flatMesh = flat->meshes[meshID];
+        std::copy(mesh->vertices.begin(),mesh->vertices.end(),
+                  flat->vertices.data()+flatMesh.firstVertex);
+        std::copy(mesh->normals.begin(),mesh->normals.end(),
+                  flat->normals.data()+flatMesh.firstNormal);
+        std::copy(mesh->texcoords.begin(),mesh->texcoords.end(),
+                  flat->texcoords.data()+flatMesh.firstTexcoord);
+        mesh->withIndices(CopyIndices{flat->indices.data()+flatMesh.firstTriangle});
+      });
+
+    // ------------------------------------------------------------------
+    // objects: null meshes get dropped, as they do in files
+    // ------------------------------------------------------------------
+    const size_t numObjects = serialized.objects.size();
+    flat->objects.resize(numObjects);
+    size_t numObjectMeshes = 0;
+    for (size_t objID=0;objID<numObjects;objID++) {
+      const Object::SP &object = serialized.objects[(int)objID];
+      FlatObject &flatObject = flat->objects[objID];
+      flatObject.firstMesh = numObjectMeshes;
+      flatObject.numMeshes = 0;
+      for (auto &mesh : object->meshes)
+        if (mesh) flatObject.numMeshes++;
+      numObjectMeshes += flatObject.numMeshes;
+    }
+    flat->objectMeshes.resize(numObjectMeshes);
+    parallel_for(numObjects,[&](size_t objID){
+        uint32_t *meshIDs = flat->objectMeshes.data()+flat->objects[objID].firstMesh;
+        for (auto &mesh : serialized.objects[(int)objID]->meshes)
+          if (mesh) *meshIDs++ = (uint32_t)serialized.getID(mesh);
+      });
+
+    // ------------------------------------------------------------------
+    // instances: null ones (and those of null objects) get dropped;
+    // each task counts, and then writes, those of one range
+    // ------------------------------------------------------------------
+    const size_t instancesPerTask = 16*1024;
+    const size_t numTasks = (scene->instances.size()+instancesPerTask-1)/instancesPerTask;
+    auto isValid = [&](size_t instID) {
+      const Instance::SP &inst = scene->instances[instID];
+      return inst && inst->object;
+    };
+    std::vector<size_t> taskBegin(numTasks+1,0);
+    parallel_for(numTasks,[&](size_t taskID){
+        const size_t end = std::min(scene->instances.size(),(taskID+1)*instancesPerTask);
+        for (size_t instID=taskID*instancesPerTask;instID<end;instID++)
+          if (isValid(instID)) taskBegin[taskID+1]++;
+      });
+    for (size_t taskID=0;taskID<numTasks;taskID++)
+      taskBegin[taskID+1] += taskBegin[taskID];
+    flat->transforms.resize(taskBegin[numTasks]);
+    flat->objectIDs.resize(taskBegin[numTasks]);
+    parallel_for(numTasks,[&](size_t taskID){
+        const size_t end = std::min(scene->instances.size(),(taskID+1)*instancesPerTask);
+        size_t out = taskBegin[taskID];
+        for (size_t instID=taskID*instancesPerTask;instID<end;instID++) {
+          if (!isValid(instID)) continue;
+          const Instance::SP &inst = scene->instances[instID];
+          flat->transforms[out] = inst->xfm;
+          flat->objectIDs[out]  = (uint32_t)serialized.getID(inst->object);
+          out++;
+        }
+      });
+
+    flat->quadLights = scene->quadLights;
+    flat->dirLights  = scene->dirLights;
+    return flat;
+  }
+
+  void FlatScene::save(const std::string &fileName) const
+  {
+    std::ofstream out(fileName,std::ios::binary);
+    if (!out.good())
+      throw std::runtime_error("could not open '"+fileName+"' for writing");
+
+    FlatFileHeader header = {};
+    header.magic           = FLAT_MAGIC;
+    header.version         = FLAT_VERSION;
+    header.numArrays       = NUM_FLAT_ARRAYS;
+    header.envMapTextureID = envMapTextureID;
+    header.envMapTransform = envMapTransform;
+    FlatLayout layout = { header, sizeof(header), 0 };
+    forEachArray(*this,layout);
+
+    out.write((const char *)&header,sizeof(header));
+    FlatWriter writer = { header, out, sizeof(header), 0 };
+    forEachArray(*this,writer);
+    if (!out.good())
+      throw std::runtime_error("error writing '"+fileName+"'");
+  }
+
+  FlatScene::SP FlatScene::load(const std::string &fileName)
+  {
+    MappedFile::SP file = MappedFile::open(fileName);
+    FlatFileHeader header;
+    if (file->size < sizeof(header))
+      throw std::runtime_error("'"+fileName+"' is not a flat scene file");
+    memcpy((void*)&header,file->data,sizeof(header));
+    if (header.magic != FLAT_MAGIC)
+      throw std::runtime_error("'"+fileName+"' is not a flat scene file");
+    if (header.version != FLAT_VERSION || header.numArrays != NUM_FLAT_ARRAYS)
+      throw std::runtime_error("'"+fileName+"' is of an unsupported flat scene version");
+
+    FlatScene::SP flat = std::make_shared<FlatScene>();
+    flat->envMapTextureID = header.envMapTextureID;
+    flat->envMapTransform = header.envMapTransform;
+    FlatViewer viewer = { header, file, 0 };
+    forEachArray(*flat,viewer);
+
+    /* no fixups - but make sure no index points outside of its
+       table, so renderers can trust them */
+    auto check = [&](bool ok) {
+      if (!ok) throw std::runtime_error("corrupt flat scene file '"+fileName+"'");
+    };
+    for (auto &mesh : flat->meshes) {
+      check(mesh.numVertices  <= flat->vertices.size()  &&
+            mesh.firstVertex  <= flat->vertices.size()-mesh.numVertices);
+      check(mesh.numNormals   <= flat->normals.size()   &&
+            mesh.firstNormal  <= flat->normals.size()-mesh.numNormals);
+      check(mesh.numTexcoords <= flat->texcoords.size() &&
+            mesh.firstTexcoord <= flat->texcoords.size()-mesh.numTexcoords);
+      check(mesh.numTriangles <= flat->indices.size()   &&
+            mesh.firstTriangle <= flat->indices.size()-mesh.numTriangles);
+      check(mesh.materialID >= 0 && mesh.materialID < (int)flat->materials.size());
+    }
+    for (auto &object : flat->objects)
+      check(object.numMeshes <= flat->objectMeshes.size() &&
+            object.firstMesh <= flat->objectMeshes.size()-object.numMeshes);
+    for (auto meshID : flat->objectMeshes)
+      check(meshID < flat->meshes.size());
+    check(flat->transforms.size() == flat->objectIDs.size());
+    for (auto objectID : flat->objectIDs)
+      check(objectID < flat->objects.size());
+    for (auto &material : flat->materials)
+      check(material.colorTextureID >= -1 && material.colorTextureID < (int)flat->textures.size() &&
+            material.alphaTextureID >= -1 && material.alphaTextureID < (int)flat->textures.size());
+    for (auto &texture : flat->textures)
+      check(texture.numBytes  <= flat->texels.size() &&
+            texture.firstByte <= flat->texels.size()-texture.numBytes);
+    check(flat->envMapTextureID >= -1 && flat->envMapTextureID < (int)flat->textures.size());
+    return flat;
+  }
+  
+} // ::mini
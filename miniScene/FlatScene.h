@@ -0,0 +1,140 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  /*! a mesh of a FlatScene: where its arrays are in the flat scene's
+      pools. Arrays a mesh doesn't have have a count of 0 */
+  struct FlatMesh {
+    uint64_t firstVertex;
+    uint64_t numVertices;
+    uint64_t firstNormal;
+    uint64_t numNormals;
+    uint64_t firstTexcoord;
+    uint64_t numTexcoords;
+    /*! the mesh's triangles; their vertex indices are relative to
+        the mesh's first vertex (ie, exactly those of the Mesh) */
+    uint64_t firstTriangle;
+    uint64_t numTriangles;
+    /*! index into FlatScene::materials */
+    int32_t  materialID;
+    int32_t  padding { 0 };
+  };
+
+  /*! an object of a FlatScene: its meshes are the IDs
+      FlatScene::objectMeshes[firstMesh..firstMesh+numMeshes) */
+  struct FlatObject {
+    uint64_t firstMesh;
+    uint64_t numMeshes;
+  };
+
+  /*! a material of a FlatScene, with textures referred to by index
+      into FlatScene::textures (-1 for 'none') */
+  struct FlatMaterial {
+    vec3f   emission;
+    vec3f   baseColor;
+    float   metallic;
+    float   roughness;
+    float   transmission;
+    float   ior;
+    int32_t colorTextureID;
+    int32_t alphaTextureID;
+  };
+
+  /*! a texture of a FlatScene, whose data are the bytes
+      FlatScene::texels[firstByte..firstByte+numBytes) */
+  struct FlatTexture {
+    int32_t  format;
+    vec2i    size;
+    int32_t  padding { 0 };
+    uint64_t firstByte;
+    uint64_t numBytes;
+  };
+  
+  /*! a scene 'compiled' into what a renderer actually wants: a few
+      contiguous arrays that refer to each other by index, rather than
+      a graph of shared_ptr's. All vertices (normals, texcoords,
+      triangles) of all unique meshes are in one pool each, with each
+      mesh being a range in those; objects are ranges of mesh IDs;
+      instances are a transform and an object ID each; materials and
+      textures are tables. Null instances, objects and meshes get
+      dropped, as do textures with identical content (see
+      SerializedScene).
+
+      Everything in here is plain data without any pointers, so a
+      FlatScene gets saved as its arrays, and load() can use those
+      arrays right where they are in the (memory-mapped) file */
+  struct FlatScene {
+    typedef std::shared_ptr<FlatScene> SP;
+
+    /*! compiles the given scene; the (potentially large) copying
+        gets done in parallel */
+    static SP compile(const Scene *scene);
+
+    /*! loads a flat scene written by save(); all arrays become views
+        into the memory-mapped file */
+    static SP load(const std::string &fileName);
+
+    /*! writes this flat scene to the given file */
+    void save(const std::string &fileName) const;
+
+    /*! returns the vertices etc of the given mesh; pointers into the
+        respective pools */
+    inline const vec3f *getVertices(size_t meshID) const
+    { return vertices.data()+meshes[meshID].firstVertex; }
+    inline const vec3f *getNormals(size_t meshID) const
+    { return normals.data()+meshes[meshID].firstNormal; }
+    inline const vec2f *getTexcoords(size_t meshID) const
+    { return texcoords.data()+meshes[meshID].firstTexcoord; }
+    inline const vec3i *getIndices(size_t meshID) const
+    { return indices.data()+meshes[meshID].firstTriangle; }
+    
+    /*! pools all meshes' arrays are ranges of */
+    Array<vec3f>        vertices;
+    Array<vec3f>        normals;
+    Array<vec2f>        texcoords;
+    Array<vec3i>        indices;
+    Array<FlatMesh>     meshes;
+
+    /*! pool of mesh IDs that objects are ranges of */
+    Array<uint32_t>     objectMeshes;
+    Array<FlatObject>   objects;
+
+    /*! one transform and object ID per (non-null) instance; the
+        transforms can be handed to a renderer's top-level
+        acceleration structure build as they are */
+    Array<affine3f>     transforms;
+    Array<uint32_t>     objectIDs;
+
+    Array<FlatMaterial> materials;
+    Array<FlatTexture>  textures;
+    /*! pool of all textures' data, each texture's data aligned to 16
+        bytes */
+    Array<uint8_t>      texels;
+
+    Array<QuadLight>    quadLights;
+    Array<DirLight>     dirLights;
+    /*! index into 'textures', or -1 if the scene has no env-map */
+    int32_t             envMapTextureID { -1 };
+    affine3f            envMapTransform;
+  };
+  
+} // ::mini
@@ -0,0 +1,76 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "miniScene/Hash.h"
+
+namespace mini {
+
+  static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+  static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+  static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+  static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+  static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+    
+  inline uint64_t rotl(uint64_t v, int r)
+  { return (v << r) | (v >> (64-r)); }
+
+  inline uint64_t read64(const uint8_t *ptr)
+  {
+    uint64_t v;
+    memcpy(&v,ptr,sizeof(v));
+    return v;
+  }
+  
+  inline uint64_t hashRound(uint64_t acc, uint64_t v)
+  { return rotl(acc + v*PRIME2,31)*PRIME1; }
+
+  inline uint64_t hashMerge(uint64_t acc, uint64_t lane)
+  { return (acc ^ hashRound(0,lane))*PRIME1 + PRIME4; }
+  
+  uint64_t hashBytes(const void *data, size_t numBytes, uint64_t seed)
+  {
+    const uint8_t *ptr = (const uint8_t *)data;
+    const uint8_t *const end = ptr+numBytes;
+    uint64_t h;
+    if (numBytes >= 32) {
+      uint64_t lane[4] = {
+        seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1
+      };
+      for (;ptr+32 <= end;ptr += 32)
+        for (int i=0;i<4;i++)
+          lane[i] = hashRound(lane[i],read64(ptr+8*i));
+      h = rotl(lane[0],1) + rotl(lane[1],7) + rotl(lane[2],12) + rotl(lane[3],18);
+      for (int i=0;i<4;i++)
+        h = hashMerge(h,lane[i]);
+    } else
+      h = seed + PRIME5;
+    h += numBytes;
+
+    for (;ptr+8 <= end;ptr += 8)
+      h = rotl(h ^ hashRound(0,read64(ptr)),27)*PRIME1 + PRIME4;
+    for (;ptr < end;ptr++)
+      h = rotl(h ^ (*ptr * PRIME5),11)*PRIME1;
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+  }
+  
+} // ::mini
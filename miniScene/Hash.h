@@ -0,0 +1,32 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+
+  /*! fast, non-cryptographic 64-bit hash of the given bytes (in the
+      spirit of xxHash64: four independent multiply-rotate lanes over
+      32-byte stripes, which keeps the CPU's multipliers busy and
+      runs at close to memory bandwidth). Only good for finding
+      candidates for equality - never take equal hashes to mean
+      equal data */
+  uint64_t hashBytes(const void *data, size_t numBytes, uint64_t seed = 0);
+  
+} // ::mini
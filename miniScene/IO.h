@@ -17,6 +17,10 @@
 #pragma once
 
 #include "miniScene/common.h"
+#include "miniScene/Array.h"
+#include "miniScene/Arena.h"
+#include "miniScene/MappedFile.h"
+#include "miniScene/Compression.h"
 // std
 #include <fstream>
 
@@ -28,10 +32,49 @@ namespace mini {
       { return std::is_trivially_copyable<T>::value; }
 
       template<> inline bool safe_to_copy_binary<vec3i>() { return true; }
+      template<> inline bool safe_to_copy_binary<vec3us>() { return true; }
       template<> inline bool safe_to_copy_binary<vec3f>() { return true; }
       template<> inline bool safe_to_copy_binary<vec4i>() { return true; }
       template<> inline bool safe_to_copy_binary<vec4f>() { return true; }
+      template<> inline bool safe_to_copy_binary<affine3f>() { return true; }
 
+      enum {
+        /*! when array alignment is enabled (see alignArrays()), array
+            payloads start at a multiple of 1<<ARRAY_ALIGNMENT_SHIFT
+            (64) bytes in the file ... */
+        ARRAY_ALIGNMENT_SHIFT       = 6,
+        /*! ... or, for arrays of at least LARGE_ARRAY_SIZE bytes, at a
+            multiple of the page size */
+        LARGE_ARRAY_ALIGNMENT_SHIFT = 12,
+        LARGE_ARRAY_SIZE            = 256*1024,
+        /*! an array's element count stores the alignment of its
+            payload (as a shift; 0 for unaligned) in the low bits of
+            its top byte ... */
+        ARRAY_COUNT_BITS            = 56,
+        ARRAY_ALIGNMENT_MASK        = 0x7f,
+        /*! ... and the top byte's high bit flags arrays stored as
+            CompressedBlocks (which are never aligned) */
+        ARRAY_FLAG_COMPRESSED       = 0x80
+      };
+      
+      /*! whether arrays written to the given stream get their payload
+          aligned. This is stored with the stream itself (like any
+          other stream formatting flag), so it applies to everything
+          written through that stream */
+      inline long &alignArrays(std::ios_base &stream)
+      {
+        static const int index = std::ios_base::xalloc();
+        return stream.iword(index);
+      }
+      
+      /*! whether (large) arrays written to the given stream get
+          stored compressed; see alignArrays() */
+      inline long &compressArrays(std::ios_base &stream)
+      {
+        static const int index = std::ios_base::xalloc();
+        return stream.iword(index);
+      }
+      
       template<typename T>
       inline void readElement(std::istream &in, T &t)
       {
@@ -51,21 +94,105 @@ namespace mini {
           throw std::runtime_error("partial read");
       }
 
+      /*! reads an array's element count, and skips the padding that
+          aligns its payload (if any); 'compressed' tells whether the
+          payload is stored as CompressedBlocks */
+      inline size_t readArrayCount(std::istream &in, bool &compressed)
+      {
+        size_t N;
+        readElement(in,N);
+        const int flags = int(N >> ARRAY_COUNT_BITS);
+        N &= (size_t(1) << ARRAY_COUNT_BITS)-1;
+        compressed = (flags & ARRAY_FLAG_COMPRESSED) != 0;
+        const int alignmentShift = flags & ARRAY_ALIGNMENT_MASK;
+        if (alignmentShift) {
+          const size_t alignment = size_t(1) << alignmentShift;
+          const size_t pos = (size_t)in.tellg();
+          in.ignore((alignment - pos % alignment) % alignment);
+          if (!in.good())
+            throw std::runtime_error("partial read");
+        }
+        return N;
+      }
+
+      /*! reads the CompressedBlocks of an array of 'numBytes' bytes */
+      inline void readCompressedBlocks(std::istream &in, size_t numBytes,
+                                       CompressedBlocks &cb)
+      {
+        readElement(in,cb.blockSize);
+        readElement(in,cb.shuffleWidth);
+        if (cb.blockSize == 0)
+          throw std::runtime_error("corrupt compressed array");
+        cb.blockEnds.resize((numBytes+cb.blockSize-1)/cb.blockSize);
+        readArray(in,cb.blockEnds.data(),cb.blockEnds.size());
+        const size_t numCompressed = cb.blockEnds.empty() ? 0 : cb.blockEnds.back();
+        if (numCompressed > numBytes)
+          throw std::runtime_error("corrupt compressed array");
+        cb.bytes.resize(numCompressed);
+        readArray(in,cb.bytes.data(),numCompressed);
+      }
+      
+      /*! reads a compressed array's payload into given memory */
+      template<typename In, typename T>
+      inline void readCompressedArray(In &in, T *t, size_t N)
+      {
+        if (!safe_to_copy_binary<T>())
+          throw std::runtime_error("unexpected compressed array");
+        CompressedBlocks cb;
+        readCompressedBlocks(in,N*sizeof(T),cb);
+        cb.decompress(t,N*sizeof(T));
+      }
+      
       template<typename T>
       inline void readVector(std::istream &in,
                              std::vector<T> &t,
                              const std::string &description="<no description>")
       {
-        size_t N;
-        readElement(in,N);
+        bool compressed;
+        size_t N = readArrayCount(in,compressed);
         t.resize(N);
-        if (safe_to_copy_binary<T>())
+        if (compressed)
+          readCompressedArray(in,t.data(),N);
+        else if (safe_to_copy_binary<T>())
           in.read((char*)t.data(),N*sizeof(t[0]));
         else
           for (size_t i=0;i<N;i++)
             readElement(in,t[i]);
       }
 
+      template<typename T>
+      inline void readVector(std::istream &in,
+                             Array<T> &t,
+                             const std::string &description="<no description>")
+      {
+        bool compressed;
+        size_t N = readArrayCount(in,compressed);
+        t.clear();
+        t.resize(N);
+        if (compressed)
+          readCompressedArray(in,t.data(),N);
+        else
+          readArray(in,t.data(),N);
+      }
+
+      /*! as above, but with the array's elements in the given arena
+          (unless that is null) */
+      template<typename T>
+      inline void readVector(std::istream &in, Array<T> &t, Arena *arena)
+      {
+        if (!arena) {
+          readVector(in,t);
+          return;
+        }
+        bool compressed;
+        size_t N = readArrayCount(in,compressed);
+        t = arena->allocateArray<T>(N);
+        if (compressed)
+          readCompressedArray(in,t.data(),N);
+        else
+          readArray(in,t.data(),N);
+      }
+
       template<typename T>
       inline void writeElement(std::ostream &out, const T &t)
       {
@@ -85,11 +212,55 @@ namespace mini {
         assert(out.good());
       }
     
+      /*! writes an array's element count; if array alignment is
+          enabled on this stream, also pads the stream up to where the
+          array's payload has to start */
+      inline void writeArrayCount(std::ostream &out, size_t N, size_t numBytes)
+      {
+        if (N == 0 || !alignArrays(out)) {
+          writeElement(out,N);
+          return;
+        }
+        const int alignmentShift
+          = numBytes >= LARGE_ARRAY_SIZE
+          ? LARGE_ARRAY_ALIGNMENT_SHIFT
+          : ARRAY_ALIGNMENT_SHIFT;
+        writeElement(out,N | (size_t(alignmentShift) << ARRAY_COUNT_BITS));
+        const size_t alignment = size_t(1) << alignmentShift;
+        const size_t pos = (size_t)out.tellp();
+        static const char zeroes[size_t(1) << LARGE_ARRAY_ALIGNMENT_SHIFT] = {};
+        out.write(zeroes,(alignment - pos % alignment) % alignment);
+      }
+      
+      /*! if array compression is enabled on this stream, and
+          compressing the given array pays off, writes it compressed
+          (count and payload), and returns true; else writes nothing,
+          and returns false */
+      template<typename T>
+      inline bool writeCompressedArray(std::ostream &out, const T *t, size_t N)
+      {
+        const size_t numBytes = N*sizeof(T);
+        if (!compressArrays(out) || !safe_to_copy_binary<T>() ||
+            numBytes < CompressedBlocks::MIN_SIZE)
+          return false;
+        CompressedBlocks::SP cb = CompressedBlocks::compress(t,numBytes,sizeof(T));
+        if (!cb)
+          return false;
+        writeElement(out,N | (size_t(ARRAY_FLAG_COMPRESSED) << ARRAY_COUNT_BITS));
+        writeElement(out,cb->blockSize);
+        writeElement(out,cb->shuffleWidth);
+        writeArray(out,cb->blockEnds.data(),cb->blockEnds.size());
+        writeArray(out,cb->bytes.data(),cb->bytes.size());
+        return true;
+      }
+      
       template<typename T>
       void writeVector(std::ostream &out, const std::vector<T> &vt)
       {
         size_t N = vt.size();
-        writeElement(out,N);
+        if (writeCompressedArray(out,vt.data(),N))
+          return;
+        writeArrayCount(out,N,N*sizeof(T));
         if (safe_to_copy_binary<T>())
           out.write((char*)vt.data(),N*sizeof(vt[0]));
         else
@@ -98,6 +269,16 @@ namespace mini {
         assert(out.good());
       }
 
+      template<typename T>
+      void writeVector(std::ostream &out, const Array<T> &vt)
+      {
+        size_t N = vt.size();
+        if (writeCompressedArray(out,vt.data(),N))
+          return;
+        writeArrayCount(out,N,N*sizeof(T));
+        writeArray(out,vt.data(),N);
+      }
+
       template<typename T>
       inline T readElement(std::istream &in)
       {
@@ -128,5 +309,132 @@ namespace mini {
         return s;
       }
 
+      /*! reads from a memory-mapped file; with the same interface as
+          the istream-based read functions above, but arrays read
+          into an Array<T> become views into the mapping (where
+          alignment permits) rather than copies */
+      struct MappedReader {
+        MappedReader(MappedFile::SP file, size_t offset=0)
+          : file(file), offset(offset)
+        {}
+
+        /*! returns pointer to the next N bytes, and advances past them */
+        const uint8_t *consume(size_t numBytes)
+        {
+          if (numBytes > file->size || offset > file->size-numBytes)
+            throw std::runtime_error("partial read");
+          const uint8_t *ptr = file->data+offset;
+          offset += numBytes;
+          return ptr;
+        }
+        
+        MappedFile::SP file;
+        size_t         offset;
+      };
+
+      template<typename T>
+      inline void readElement(MappedReader &in, T &t)
+      {
+        memcpy((void*)&t,in.consume(sizeof(t)),sizeof(t));
+      }
+
+      template<typename T>
+      inline T readElement(MappedReader &in)
+      {
+        T t;
+        io::readElement(in,t);
+        return t;
+      }
+
+      template<typename T>
+      inline void readArray(MappedReader &in, T *t, size_t N)
+      {
+        if (N > in.file->size/sizeof(T))
+          throw std::runtime_error("partial read");
+        memcpy((void*)t,in.consume(N*sizeof(T)),N*sizeof(T));
+      }
+      
+      inline size_t readArrayCount(MappedReader &in, bool &compressed)
+      {
+        size_t N;
+        readElement(in,N);
+        const int flags = int(N >> ARRAY_COUNT_BITS);
+        N &= (size_t(1) << ARRAY_COUNT_BITS)-1;
+        compressed = (flags & ARRAY_FLAG_COMPRESSED) != 0;
+        const int alignmentShift = flags & ARRAY_ALIGNMENT_MASK;
+        if (alignmentShift) {
+          const size_t alignment = size_t(1) << alignmentShift;
+          in.consume((alignment - in.offset % alignment) % alignment);
+        }
+        return N;
+      }
+      
+      /*! reads the CompressedBlocks of an array of 'numBytes' bytes;
+          the compressed bytes are a view into the mapping */
+      inline void readCompressedBlocks(MappedReader &in, size_t numBytes,
+                                       CompressedBlocks &cb)
+      {
+        readElement(in,cb.blockSize);
+        readElement(in,cb.shuffleWidth);
+        if (cb.blockSize == 0)
+          throw std::runtime_error("corrupt compressed array");
+        const size_t numBlocks = (numBytes+cb.blockSize-1)/cb.blockSize;
+        if (numBlocks > in.file->size/sizeof(uint64_t))
+          throw std::runtime_error("partial read");
+        cb.blockEnds.resize(numBlocks);
+        readArray(in,cb.blockEnds.data(),numBlocks);
+        const size_t numCompressed = numBlocks ? cb.blockEnds[numBlocks-1] : 0;
+        if (numCompressed > numBytes)
+          throw std::runtime_error("corrupt compressed array");
+        cb.bytes = Array<uint8_t>::view((uint8_t*)in.consume(numCompressed),
+                                        numCompressed,in.file);
+      }
+      
+      template<typename T>
+      inline void readVector(MappedReader &in,
+                             std::vector<T> &t,
+                             const std::string &description="<no description>")
+      {
+        bool compressed;
+        size_t N = readArrayCount(in,compressed);
+        t.resize(N);
+        if (compressed)
+          readCompressedArray(in,t.data(),N);
+        else
+          readArray(in,t.data(),N);
+      }
+
+      template<typename T>
+      inline void readVector(MappedReader &in,
+                             Array<T> &t,
+                             const std::string &description="<no description>")
+      {
+        bool compressed;
+        size_t N = readArrayCount(in,compressed);
+        if (compressed) {
+          /* compressed data cannot be viewed - decompress instead */
+          t.clear();
+          t.resize(N);
+          readCompressedArray(in,t.data(),N);
+          return;
+        }
+        if (N > in.file->size/sizeof(T))
+          throw std::runtime_error("partial read");
+        T *ptr = (T*)in.consume(N*sizeof(T));
+        if (N == 0 || (size_t)ptr % alignof(T) != 0) {
+          /* unaligned data cannot be viewed - copy instead */
+          t.clear();
+          t.resize(N);
+          if (N) memcpy((void*)t.data(),ptr,N*sizeof(T));
+        } else
+          t = Array<T>::view(ptr,N,in.file);
+      }
+
+      /*! arrays read from a mapping are views into that anyway, so
+          there's nothing to put in an arena */
+      template<typename T>
+      inline void readVector(MappedReader &in, Array<T> &t, Arena *arena)
+      { readVector(in,t); }
+    
     } // ::mini::io
 } // ::mini
@@ -0,0 +1,107 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/IndexCodec.h"
+
+namespace mini {
+
+  inline uint32_t zigzag(int32_t i)
+  { return (uint32_t(i) << 1) ^ uint32_t(i >> 31); }
+  
+  inline int32_t unzigzag(uint32_t u)
+  { return int32_t(u >> 1) ^ -int32_t(u & 1); }
+  
+  CompressedIndices::SP CompressedIndices::encode(const Array<vec3i> &indices)
+  {
+    CompressedIndices::SP ci = std::make_shared<CompressedIndices>();
+    ci->numTriangles = indices.size();
+
+    const size_t numChunks
+      = (indices.size()+TRIANGLES_PER_CHUNK-1)/TRIANGLES_PER_CHUNK;
+    std::vector<std::vector<uint8_t>> chunks(numChunks);
+    parallel_for(numChunks,[&](size_t chunkID){
+        const size_t begin = chunkID*TRIANGLES_PER_CHUNK;
+        const size_t end   = std::min(begin+TRIANGLES_PER_CHUNK,indices.size());
+        std::vector<uint8_t> &out = chunks[chunkID];
+        out.reserve(6*(end-begin));
+        int32_t prev = 0;
+        for (size_t i=begin;i<end;i++)
+          for (int d=0;d<3;d++) {
+            const int32_t idx = indices[i][d];
+            /* wrap-around arithmetic, so any delta fits into 32 bits */
+            uint32_t u = zigzag(int32_t(uint32_t(idx)-uint32_t(prev)));
+            prev = idx;
+            while (u >= 0x80) {
+              out.push_back(uint8_t(u | 0x80));
+              u >>= 7;
+            }
+            out.push_back(uint8_t(u));
+          }
+      });
+
+    size_t numBytes = 0;
+    for (auto &chunk : chunks) {
+      numBytes += chunk.size();
+      ci->chunkEnds.push_back(numBytes);
+    }
+    ci->bytes.resize(numBytes);
+    parallel_for(numChunks,[&](size_t chunkID){
+        size_t begin = chunkID ? (size_t)ci->chunkEnds[chunkID-1] : 0;
+        std::copy(chunks[chunkID].begin(),chunks[chunkID].end(),
+                  ci->bytes.data()+begin);
+      });
+    return ci;
+  }
+
+  void CompressedIndices::decode(Array<vec3i> &indices) const
+  {
+    const size_t numChunks
+      = (numTriangles+TRIANGLES_PER_CHUNK-1)/TRIANGLES_PER_CHUNK;
+    if (chunkEnds.size() != numChunks ||
+        (numChunks && chunkEnds[numChunks-1] != bytes.size()))
+      throw std::runtime_error("corrupt compressed indices");
+    /* every chunk has to lie within 'bytes', and must not start
+       after it ends */
+    for (size_t chunkID=0;chunkID<numChunks;chunkID++)
+      if (chunkEnds[chunkID] > bytes.size() ||
+          (chunkID && chunkEnds[chunkID] < chunkEnds[chunkID-1]))
+        throw std::runtime_error("corrupt compressed indices");
+    
+    indices.clear();
+    indices.resize(numTriangles);
+    int32_t *out = (int32_t*)indices.data();
+    parallel_for(numChunks,[&](size_t chunkID){
+        const size_t begin = chunkID*TRIANGLES_PER_CHUNK;
+        const size_t end   = std::min(begin+TRIANGLES_PER_CHUNK,size_t(numTriangles));
+        const uint8_t *in     = bytes.data()+(chunkID ? chunkEnds[chunkID-1] : 0);
+        const uint8_t *in_end = bytes.data()+chunkEnds[chunkID];
+        int32_t prev = 0;
+        for (size_t i=3*begin;i<3*end;i++) {
+          uint32_t u = 0;
+          for (int shift=0;;shift+=7) {
+            if (in == in_end || shift > 28)
+              throw std::runtime_error("corrupt compressed indices");
+            const uint8_t byte = *in++;
+            u |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+          }
+          prev = int32_t(uint32_t(prev)+uint32_t(unzigzag(u)));
+          out[i] = prev;
+        }
+      });
+  }
+  
+} // ::mini
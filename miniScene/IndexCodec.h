@@ -0,0 +1,50 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Array.h"
+
+namespace mini {
+
+  /*! triangle indices, compressed by coding each index as the
+      zigzag-encoded difference to the index before it, stored as a
+      varint (7 bits per byte, high bit set on all but the last byte
+      of a value). Meshes with good vertex locality need 1-2 bytes
+      per index rather than 4. The triangles are coded in chunks of
+      TRIANGLES_PER_CHUNK that each start from scratch, so the chunks
+      of large meshes can be decoded in parallel */
+  struct CompressedIndices {
+    typedef std::shared_ptr<CompressedIndices> SP;
+
+    enum { TRIANGLES_PER_CHUNK = 16*1024 };
+
+    static SP encode(const Array<vec3i> &indices);
+
+    /*! decodes into given array (which gets resized as required) */
+    void decode(Array<vec3i> &indices) const;
+
+    /*! number of bytes this takes up in a file (approximately) */
+    size_t sizeInBytes() const
+    { return chunkEnds.size()*sizeof(uint64_t)+bytes.size(); }
+
+    size_t          numTriangles { 0 };
+    /*! for each chunk, the offset in 'bytes' where that chunk ends */
+    Array<uint64_t> chunkEnds;
+    Array<uint8_t>  bytes;
+  };
+  
+} // ::mini
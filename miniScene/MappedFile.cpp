@@ -0,0 +1,102 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/MappedFile.h"
+#include "miniScene/PositionalIO.h"
+#ifdef _WIN32
+# include <fstream>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace mini {
+
+#ifdef _WIN32
+  MappedFile::SP MappedFile::open(const std::string &fileName)
+  {
+    std::ifstream in(fileName,std::ios::binary|std::ios::ate);
+    if (!in.good())
+      throw std::runtime_error("could not open file '"+fileName+"'");
+    MappedFile::SP file = std::make_shared<MappedFile>();
+    file->heapCopy.resize((size_t)in.tellg());
+    in.seekg(0);
+    in.read((char*)file->heapCopy.data(),file->heapCopy.size());
+    if (!in.good())
+      throw std::runtime_error("could not read file '"+fileName+"'");
+    file->data = file->heapCopy.data();
+    file->size = file->heapCopy.size();
+    return file;
+  }
+
+  MappedFile::~MappedFile()
+  {}
+
+  void MappedFile::release(size_t offset, size_t numBytes)
+  {}
+#else
+  MappedFile::SP MappedFile::open(const std::string &fileName)
+  {
+    int fd = ::open(fileName.c_str(),O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("could not open file '"+fileName+"'");
+    struct stat st;
+    if (fstat(fd,&st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("could not stat file '"+fileName+"'");
+    }
+    MappedFile::SP file = std::make_shared<MappedFile>();
+    file->size  = (size_t)st.st_size;
+    file->inUse = std::make_shared<io::FileInUse>(st.st_dev,st.st_ino);
+    if (file->size > 0) {
+      /* private+writable so arrays viewing this memory can still be
+         modified in place (copy-on-write); noreserve so mapping a
+         file larger than available swap doesn't get refused */
+      void *mem = mmap(nullptr,file->size,PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_NORESERVE,fd,0);
+      if (mem == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("could not mmap file '"+fileName+"'");
+      }
+      file->data = (uint8_t*)mem;
+    }
+    /* the mapping stays valid after the descriptor is closed */
+    ::close(fd);
+    return file;
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if (data) munmap(data,size);
+  }
+
+  void MappedFile::release(size_t offset, size_t numBytes)
+  {
+    if (!data || offset >= size) return;
+    numBytes = std::min(numBytes,size-offset);
+    /* only drop pages that lie entirely within the range, their
+       neighbors may still be in use */
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (offset+pageSize-1)/pageSize*pageSize;
+    size_t end   = (offset+numBytes)/pageSize*pageSize;
+    if (end > begin)
+      madvise(data+begin,end-begin,MADV_DONTNEED);
+  }
+#endif
+  
+} // ::mini
@@ -0,0 +1,53 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+  namespace io {
+    struct FileInUse;
+  }
+
+  /*! a read-only file mapped into memory (copy-on-write, so pages
+      may be modified in memory without ever changing the file). On
+      platforms without mmap the file content simply gets read into a
+      heap buffer */
+  struct MappedFile {
+    typedef std::shared_ptr<MappedFile> SP;
+
+    /*! maps the given file; throws if it cannot be opened */
+    static SP open(const std::string &fileName);
+
+    ~MappedFile();
+
+    /*! hints that the given range won't be accessed for a while, so
+        the OS may drop its pages (they get re-read from the file on
+        the next access; in-memory modifications of them are lost!).
+        Lets sequential passes over huge files run in constant
+        memory */
+    void release(size_t offset, size_t numBytes);
+
+    uint8_t *data { nullptr };
+    size_t   size { 0 };
+  private:
+    std::vector<uint8_t> heapCopy;
+    /*! marks the mapped file as in use for as long as it's mapped */
+    std::shared_ptr<io::FileInUse> inUse;
+  };
+  
+} // ::mini
@@ -0,0 +1,159 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/MeshPager.h"
+
+namespace mini {
+
+  MeshPager::MeshPager(const std::string &fileName,
+                       const std::vector<TOC::Chunk> &meshChunks,
+                       size_t memoryBudget)
+    : memoryBudget(memoryBudget),
+      file(std::make_shared<io::PositionalReadFile>(fileName)),
+      meshChunks(meshChunks)
+  {}
+
+  /*! drops (and frees) all of the given mesh's arrays */
+  inline void clearArrays(Mesh *mesh)
+  {
+    mesh->vertices  = Array<vec3f>();
+    mesh->normals   = Array<vec3f>();
+    mesh->texcoords = Array<vec2f>();
+    mesh->indices   = Array<vec3i>();
+    mesh->indices16 = Array<vec3us>();
+  }
+  
+  /*! number of bytes in the given mesh's arrays */
+  inline size_t arrayBytes(const Mesh *mesh)
+  {
+    return
+      mesh->vertices.size()*sizeof(mesh->vertices[0]) +
+      mesh->normals.size()*sizeof(mesh->normals[0]) +
+      mesh->texcoords.size()*sizeof(mesh->texcoords[0]) +
+      mesh->indices.size()*sizeof(mesh->indices[0]) +
+      mesh->indices16.size()*sizeof(mesh->indices16[0]);
+  }
+  
+  /*! reads the arrays of the (non-null) mesh stored in the given
+      record into that mesh */
+  inline void readMesh(const io::PositionalReadFile::SP &file,
+                       const TOC::Chunk &chunk, Mesh *mesh)
+  {
+    io::PositionalReadBuffer buffer(file,io::ReadQueue::SERIAL,chunk.offset);
+    std::istream in(&buffer);
+    int flags = io::readElement<int>(in);
+    if (!(flags & MESH_FLAG_VALID))
+      throw std::runtime_error("paged mesh refers to a null mesh");
+    io::readMeshArrays(in,mesh,flags);
+  }
+  
+  void MeshPager::makeResident(Mesh *mesh)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = resident.find(mesh);
+    if (it != resident.end()) {
+      if (it->second.pinCount++ == 0)
+        lru.erase(it->second.lruPos);
+      if (!it->second.loading)
+        return;
+      /* somebody else is reading it; if that fails, the entry is
+         gone once we wake up */
+      loaded.wait(lock,[&]{
+          auto it = resident.find(mesh);
+          return it == resident.end() || !it->second.loading;
+        });
+      if (resident.find(mesh) == resident.end())
+        throw std::runtime_error("could not read paged mesh");
+      return;
+    }
+
+    const int meshID = mesh->paging.meshID;
+    if (meshID < 0 || meshID >= (int)meshChunks.size())
+      throw std::runtime_error("invalid mesh ID for paged mesh");
+
+    /* the mesh is pinned while we read it, so nobody else touches
+       its arrays in the meantime */
+    resident[mesh].pinCount = 1;
+    resident[mesh].loading  = true;
+    lock.unlock();
+    try {
+      readMesh(file,meshChunks[meshID],mesh);
+    } catch (...) {
+      lock.lock();
+      resident.erase(mesh);
+      clearArrays(mesh);
+      loaded.notify_all();
+      throw;
+    }
+    lock.lock();
+    
+    Residency &residency = resident[mesh];
+    residency.loading  = false;
+    residency.numBytes = arrayBytes(mesh);
+    numResidentBytes += residency.numBytes;
+    evictUntilWithinBudget();
+    loaded.notify_all();
+  }
+
+  void MeshPager::release(Mesh *mesh)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resident.find(mesh);
+    if (it == resident.end() || it->second.pinCount == 0)
+      throw std::runtime_error("MeshPager::release() on a mesh that is not pinned");
+    if (--it->second.pinCount == 0) {
+      it->second.lruPos = lru.insert(lru.end(),mesh);
+      evictUntilWithinBudget();
+    }
+  }
+
+  void MeshPager::forget(Mesh *mesh)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resident.find(mesh);
+    if (it == resident.end()) return;
+    if (it->second.pinCount == 0)
+      lru.erase(it->second.lruPos);
+    numResidentBytes -= it->second.numBytes;
+    resident.erase(it);
+  }
+  
+  bool MeshPager::isResident(const Mesh *mesh)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resident.find(mesh);
+    return it != resident.end() && !it->second.loading;
+  }
+
+  size_t MeshPager::getResidentBytes()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numResidentBytes;
+  }
+  
+  void MeshPager::evictUntilWithinBudget()
+  {
+    while (numResidentBytes > memoryBudget && !lru.empty()) {
+      Mesh *victim = lru.front();
+      lru.pop_front();
+      auto it = resident.find(victim);
+      numResidentBytes -= it->second.numBytes;
+      resident.erase(it);
+      clearArrays(victim);
+    }
+  }
+
+} // ::mini
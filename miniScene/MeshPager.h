@@ -0,0 +1,92 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/FileFormat.h"
+#include "miniScene/PositionalIO.h"
+// std
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+
+namespace mini {
+
+  /*! manages the arrays of all 'paged' meshes of a scene loaded with
+      Scene::loadPaged(): reads a mesh's arrays from the file when
+      that mesh gets made resident, and evicts the least recently
+      used meshes that are no longer pinned whenever the arrays of
+      all resident meshes exceed the memory budget. The file stays
+      open for as long as the pager lives, so paged meshes keep
+      reading the file they were loaded from even if that gets
+      replaced (eg, by saving the scene over it). All methods are
+      thread-safe; meshes get read without holding the pager's lock,
+      so different threads can page in different meshes at the same
+      time */
+  struct MeshPager {
+    typedef std::shared_ptr<MeshPager> SP;
+
+    MeshPager(const std::string &fileName,
+              const std::vector<TOC::Chunk> &meshChunks,
+              size_t memoryBudget);
+
+    /*! makes the mesh resident (if it isn't already), and pins it */
+    void makeResident(Mesh *mesh);
+
+    /*! releases one pin on the given mesh */
+    void release(Mesh *mesh);
+
+    /*! stops tracking given mesh (called when that mesh dies) */
+    void forget(Mesh *mesh);
+    
+    bool isResident(const Mesh *mesh);
+
+    /*! number of bytes in the arrays of all currently resident meshes */
+    size_t getResidentBytes();
+    
+    /*! max number of bytes resident meshes may use before unpinned
+        ones get evicted */
+    const size_t memoryBudget;
+    
+  private:
+    struct Residency {
+      int    pinCount { 0 };
+      size_t numBytes { 0 };
+      /*! whether some thread is still reading this mesh's arrays;
+          others pinning it wait for 'loaded' */
+      bool   loading  { false };
+      /*! position in the LRU list; only valid if pinCount == 0 */
+      std::list<Mesh *>::iterator lruPos;
+    };
+
+    /*! evicts unpinned meshes until we're within budget (or there's
+        nothing left to evict); caller must hold the mutex */
+    void evictUntilWithinBudget();
+    
+    std::mutex mutex;
+    /*! notified whenever a mesh is done loading (or failed to) */
+    std::condition_variable loaded;
+    std::unordered_map<const Mesh *,Residency> resident;
+    /*! all resident meshes that aren't pinned, least recently used
+        first */
+    std::list<Mesh *> lru;
+    size_t numResidentBytes { 0 };
+
+    const io::PositionalReadFile::SP file;
+    const std::vector<TOC::Chunk>    meshChunks;
+  };
+
+} // ::mini
@@ -0,0 +1,768 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/PositionalIO.h"
+#ifdef _WIN32
+# include <fstream>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <stdlib.h>
+# include <unistd.h>
+# include <errno.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  define MINI_HAVE_IO_URING 1
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+# endif
+#endif
+// std
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <thread>
+
+namespace mini {
+  namespace io {
+
+    /*! size of the write-combining buffer of a PositionalWriteBuffer;
+        writes larger than that bypass the buffer */
+    const size_t positionalBufferSize = 1<<16;
+
+    /*! for each file in use, how many FileInUse's there are for it */
+    typedef std::map<std::pair<uint64_t,uint64_t>,int> FilesInUse;
+    
+    static FilesInUse &filesInUse(std::unique_lock<std::mutex> &lock)
+    {
+      static std::mutex mutex;
+      static FilesInUse files;
+      lock = std::unique_lock<std::mutex>(mutex);
+      return files;
+    }
+    
+    FileInUse::FileInUse(uint64_t device, uint64_t inode)
+      : device(device), inode(inode)
+    {
+      std::unique_lock<std::mutex> lock;
+      filesInUse(lock)[{device,inode}]++;
+    }
+
+    FileInUse::~FileInUse()
+    {
+      std::unique_lock<std::mutex> lock;
+      FilesInUse &files = filesInUse(lock);
+      auto it = files.find({device,inode});
+      if (--it->second == 0)
+        files.erase(it);
+    }
+    
+#ifdef _WIN32
+    bool FileInUse::isInUse(const std::string &fileName)
+    { return false; }
+
+    std::string resolveSymlinks(const std::string &fileName)
+    { return fileName; }
+
+    void copyPermissions(const std::string &from, const std::string &to)
+    {}
+#else
+    bool FileInUse::isInUse(const std::string &fileName)
+    {
+      struct stat st;
+      if (stat(fileName.c_str(),&st) != 0)
+        return false;
+      std::unique_lock<std::mutex> lock;
+      return filesInUse(lock).count({(uint64_t)st.st_dev,(uint64_t)st.st_ino}) != 0;
+    }
+
+    std::string resolveSymlinks(const std::string &fileName)
+    {
+      char *resolved = realpath(fileName.c_str(),nullptr);
+      if (!resolved)
+        return fileName;
+      const std::string result = resolved;
+      free(resolved);
+      return result;
+    }
+
+    void copyPermissions(const std::string &from, const std::string &to)
+    {
+      struct stat st;
+      if (stat(from.c_str(),&st) == 0)
+        chmod(to.c_str(),st.st_mode & 07777);
+    }
+#endif
+    
+#ifdef _WIN32
+    PositionalFile::PositionalFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      file = new std::fstream(fileName,std::ios::binary|std::ios::out|std::ios::trunc);
+      if (!file->good())
+        throw std::runtime_error("could not open file '"+fileName+"'");
+    }
+
+    PositionalFile::~PositionalFile()
+    { delete file; }
+
+    bool PositionalFile::supportsConcurrentWrites()
+    { return false; }
+    
+    void PositionalFile::write(size_t offset, const void *data, size_t numBytes)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      file->seekp(offset);
+      file->write((const char *)data,numBytes);
+      if (!file->good())
+        throw std::runtime_error("error writing to '"+fileName+"'");
+    }
+
+    void PositionalFile::resize(size_t size)
+    {}
+#else
+    PositionalFile::PositionalFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      fd = ::open(fileName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+      if (fd < 0)
+        throw std::runtime_error("could not open file '"+fileName+"'");
+    }
+
+    PositionalFile::~PositionalFile()
+    { ::close(fd); }
+
+    bool PositionalFile::supportsConcurrentWrites()
+    { return true; }
+    
+    void PositionalFile::write(size_t offset, const void *data, size_t numBytes)
+    {
+      const char *ptr = (const char *)data;
+      while (numBytes > 0) {
+        ssize_t written = pwrite(fd,ptr,numBytes,(off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0)
+          throw std::runtime_error("error writing to '"+fileName+"'");
+        ptr      += written;
+        offset   += written;
+        numBytes -= written;
+      }
+    }
+    
+    void PositionalFile::resize(size_t size)
+    {
+      if (ftruncate(fd,(off_t)size) != 0)
+        throw std::runtime_error("could not resize file '"+fileName+"'");
+    }
+#endif
+
+    PositionalWriteBuffer::PositionalWriteBuffer(PositionalFile &file, size_t offset)
+      : file(file), offset(offset)
+    {
+      buffer.resize(positionalBufferSize);
+      setp(buffer.data(),buffer.data()+buffer.size());
+    }
+
+    PositionalWriteBuffer::~PositionalWriteBuffer()
+    {
+      /* can't throw from a destructor; users are supposed to flush
+         (and check) the stream before it dies */
+      try { flushBuffer(); } catch (...) {}
+    }
+    
+    bool PositionalWriteBuffer::flushBuffer()
+    {
+      size_t numBuffered = pptr()-pbase();
+      if (numBuffered == 0) return true;
+      file.write(offset,pbase(),numBuffered);
+      offset += numBuffered;
+      setp(buffer.data(),buffer.data()+buffer.size());
+      return true;
+    }
+
+    std::streamsize PositionalWriteBuffer::xsputn(const char *s, std::streamsize n)
+    {
+      try {
+        if ((size_t)n < (size_t)(epptr()-pptr())) {
+          memcpy(pptr(),s,n);
+          pbump((int)n);
+          return n;
+        }
+        flushBuffer();
+        if ((size_t)n < buffer.size()) {
+          memcpy(pptr(),s,n);
+          pbump((int)n);
+        } else {
+          file.write(offset,s,n);
+          offset += n;
+        }
+        return n;
+      } catch (...) {
+        return 0;
+      }
+    }
+
+    PositionalWriteBuffer::int_type PositionalWriteBuffer::overflow(int_type c)
+    {
+      try {
+        flushBuffer();
+      } catch (...) {
+        return traits_type::eof();
+      }
+      if (!traits_type::eq_int_type(c,traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+      }
+      return traits_type::not_eof(c);
+    }
+    
+    int PositionalWriteBuffer::sync()
+    {
+      try {
+        flushBuffer();
+        return 0;
+      } catch (...) {
+        return -1;
+      }
+    }
+    
+    PositionalWriteBuffer::pos_type
+    PositionalWriteBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+                                   std::ios_base::openmode)
+    {
+      if (off != 0 || dir != std::ios_base::cur)
+        return pos_type(-1);
+      return pos_type(offset+(pptr()-pbase()));
+    }
+    
+    // ------------------------------------------------------------------
+    // positional reads
+    // ------------------------------------------------------------------
+    
+#ifdef _WIN32
+    PositionalReadFile::PositionalReadFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      file = new std::fstream(fileName,std::ios::binary|std::ios::in);
+      if (!file->good())
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      file->seekg(0,std::ios::end);
+      size = (size_t)file->tellg();
+    }
+
+    PositionalReadFile::~PositionalReadFile()
+    { delete file; }
+
+    size_t PositionalReadFile::read(size_t offset, void *data, size_t numBytes)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (offset >= size) return 0;
+      numBytes = std::min(numBytes,size-offset);
+      file->clear();
+      file->seekg(offset);
+      file->read((char *)data,numBytes);
+      if (!file->good())
+        throw std::runtime_error("error reading from '"+fileName+"'");
+      return numBytes;
+    }
+#else
+    PositionalReadFile::PositionalReadFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      fd = ::open(fileName.c_str(),O_RDONLY);
+      if (fd < 0)
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      struct stat st;
+      if (fstat(fd,&st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("could not stat file '"+fileName+"'");
+      }
+      size  = (size_t)st.st_size;
+      inUse = std::make_shared<FileInUse>(st.st_dev,st.st_ino);
+    }
+
+    PositionalReadFile::~PositionalReadFile()
+    { ::close(fd); }
+
+    size_t PositionalReadFile::read(size_t offset, void *data, size_t numBytes)
+    {
+      char *ptr = (char *)data;
+      size_t numRead = 0;
+      while (numRead < numBytes) {
+        ssize_t got = pread(fd,ptr+numRead,numBytes-numRead,(off_t)(offset+numRead));
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0)
+          throw std::runtime_error("error reading from '"+fileName+"'");
+        if (got == 0) break;
+        numRead += got;
+      }
+      return numRead;
+    }
+#endif
+
+    /*! reads exactly the given range of the file, or throws */
+    inline void readFully(PositionalReadFile &file,
+                          size_t offset, void *data, size_t numBytes)
+    {
+      if (file.read(offset,data,numBytes) != numBytes)
+        throw std::runtime_error("partial read");
+    }
+
+    /*! the threads that do the reads of all THREAD_POOL read queues;
+        there are as many of them as a queue has reads in flight, no
+        matter how many cores there are, because these threads spend
+        their time waiting for the device, not computing */
+    struct ReadThreads {
+      static ReadThreads &get()
+      {
+        static ReadThreads threads;
+        return threads;
+      }
+
+      ReadThreads()
+      {
+        for (int i=0;i<ReadQueue::QUEUE_DEPTH;i++)
+          threads.push_back(std::thread([this](){ work(); }));
+      }
+      
+      ~ReadThreads()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          quit = true;
+        }
+        jobAdded.notify_all();
+        for (auto &thread : threads)
+          thread.join();
+      }
+
+      void push(const std::function<void()> &job)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          jobs.push_back(job);
+        }
+        jobAdded.notify_one();
+      }
+      
+    private:
+      void work()
+      {
+        while (true) {
+          std::function<void()> job;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock,[&]{ return quit || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = jobs.front();
+            jobs.pop_front();
+          }
+          job();
+        }
+      }
+      
+      std::mutex                        mutex;
+      std::condition_variable           jobAdded;
+      std::deque<std::function<void()>> jobs;
+      bool                              quit { false };
+      std::vector<std::thread>          threads;
+    };
+
+    /*! reads the given range chunk by chunk on the ReadThreads, and
+        waits for all chunks to arrive */
+    inline void readOnThreads(PositionalReadFile &file,
+                              size_t offset, char *data, size_t numBytes)
+    {
+      struct {
+        std::mutex              mutex;
+        std::condition_variable done;
+        size_t                  numPending;
+        std::exception_ptr      error;
+      } batch;
+      batch.numPending = (numBytes+ReadQueue::CHUNK_SIZE-1)/ReadQueue::CHUNK_SIZE;
+
+      ReadThreads &threads = ReadThreads::get();
+      for (size_t begin=0;begin<numBytes;begin+=ReadQueue::CHUNK_SIZE) {
+        const size_t size = std::min(numBytes-begin,(size_t)ReadQueue::CHUNK_SIZE);
+        threads.push([&batch,&file,offset,data,begin,size](){
+            std::exception_ptr error;
+            try {
+              readFully(file,offset+begin,data+begin,size);
+            } catch (...) {
+              error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (error && !batch.error)
+              batch.error = error;
+            if (--batch.numPending == 0)
+              batch.done.notify_all();
+          });
+      }
+
+      std::unique_lock<std::mutex> lock(batch.mutex);
+      batch.done.wait(lock,[&]{ return batch.numPending == 0; });
+      if (batch.error)
+        std::rethrow_exception(batch.error);
+    }
+    
+#if MINI_HAVE_IO_URING
+    /*! an io_uring, set up with plain system calls (so we don't
+        depend on liburing), and used only for reads of one file. We
+        are the only producer of submissions and the only consumer of
+        completions, so only the kernel's side of the rings needs
+        memory barriers */
+    struct ReadQueue::Ring {
+      /*! throws if io_uring is not available (old kernel, or
+          disabled by the system's security policy) */
+      Ring(unsigned numEntries)
+      {
+        io_uring_params params;
+        memset(&params,0,sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup,numEntries,&params);
+        if (fd < 0)
+          throw std::runtime_error("io_uring not available");
+
+        sqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes  + params.cq_entries*sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap)
+          sqRingSize = cqRingSize = std::max(sqRingSize,cqRingSize);
+        sqRing = map(sqRingSize,IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing : map(cqRingSize,IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries*sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *)map(sqesSize,IORING_OFF_SQES);
+        if (!sqRing || !cqRing || !sqes) {
+          release();
+          throw std::runtime_error("could not map io_uring");
+        }
+
+        char *sq = (char *)sqRing;
+        sqHead  = (unsigned *)(sq+params.sq_off.head);
+        sqTail  = (unsigned *)(sq+params.sq_off.tail);
+        sqMask  = *(unsigned *)(sq+params.sq_off.ring_mask);
+        sqArray = (unsigned *)(sq+params.sq_off.array);
+        char *cq = (char *)cqRing;
+        cqHead  = (unsigned *)(cq+params.cq_off.head);
+        cqTail  = (unsigned *)(cq+params.cq_off.tail);
+        cqMask  = *(unsigned *)(cq+params.cq_off.ring_mask);
+        cqes    = (io_uring_cqe *)(cq+params.cq_off.cqes);
+        slots.resize(params.sq_entries);
+      }
+
+      ~Ring() { release(); }
+
+      /*! the calling thread's ring - set up on its first use, and
+          from then on shared by all queues this thread reads
+          through; null if io_uring is not available */
+      static Ring *forThisThread();
+      
+      /*! reads the given range of file 'fileFD' in chunks, with up
+          to one chunk per ring entry in flight */
+      void read(int fileFD, size_t offset, char *data, size_t numBytes);
+      
+    private:
+      void *map(size_t size, off_t what)
+      {
+        void *ptr = mmap(0,size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,what);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+      }
+      
+      void release()
+      {
+        if (sqes) munmap(sqes,sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing,cqRingSize);
+        if (sqRing) munmap(sqRing,sqRingSize);
+        ::close(fd);
+      }
+
+      /*! a range of the file, and where it goes */
+      struct Chunk {
+        size_t offset;
+        char  *data;
+        size_t size;
+      };
+      /*! what an in-flight read is reading; submissions refer to
+          these by index */
+      struct Slot {
+        Chunk  chunk;
+        iovec  iov;
+      };
+      
+      int           fd     { -1 };
+      void         *sqRing { nullptr };
+      void         *cqRing { nullptr };
+      size_t        sqRingSize, cqRingSize, sqesSize;
+      io_uring_sqe *sqes   { nullptr };
+      unsigned     *sqHead, *sqTail, *sqArray, sqMask;
+      unsigned     *cqHead, *cqTail, cqMask;
+      io_uring_cqe *cqes;
+      std::vector<Slot> slots;
+      /*! set once io_uring_enter failed on this ring; such a ring
+          doesn't get used again */
+      bool          broken { false };
+    };
+
+    ReadQueue::Ring *ReadQueue::Ring::forThisThread()
+    {
+      static thread_local std::unique_ptr<Ring> ring;
+      static thread_local bool unavailable = false;
+      if (ring && ring->broken)
+        ring.reset();
+      if (!ring && !unavailable) {
+        try {
+          ring.reset(new Ring(QUEUE_DEPTH));
+        } catch (const std::runtime_error &) {
+          unavailable = true;
+        }
+      }
+      return ring.get();
+    }
+
+    void ReadQueue::Ring::read(int fileFD, size_t offset, char *data, size_t numBytes)
+    {
+      std::vector<Chunk> todo;
+      for (size_t begin=0;begin<numBytes;begin+=CHUNK_SIZE)
+        todo.push_back({offset+begin,data+begin,
+                        std::min(numBytes-begin,(size_t)CHUNK_SIZE)});
+      std::reverse(todo.begin(),todo.end());
+      std::vector<unsigned> freeSlots;
+      for (unsigned i=0;i<slots.size();i++)
+        freeSlots.push_back(i);
+
+      /* once something failed we stop submitting, but still have to
+         wait for everything in flight - those reads write into
+         memory we don't own */
+      std::string error;
+      unsigned numInFlight = 0, numUnsubmitted = 0;
+      /* once io_uring_enter itself failed we can no longer wait in
+         the kernel, so we poll for the remaining completions */
+      bool enterFailed = false;
+      while ((!todo.empty() && error.empty()) || numInFlight > 0) {
+        unsigned tail = *sqTail;
+        while (error.empty() && !todo.empty() && !freeSlots.empty()) {
+          const unsigned slotID = freeSlots.back();
+          freeSlots.pop_back();
+          Slot &slot = slots[slotID];
+          slot.chunk = todo.back();
+          todo.pop_back();
+          slot.iov.iov_base = slot.chunk.data;
+          slot.iov.iov_len  = slot.chunk.size;
+          
+          const unsigned index = tail & sqMask;
+          io_uring_sqe &sqe = sqes[index];
+          memset(&sqe,0,sizeof(sqe));
+          sqe.opcode    = IORING_OP_READV;
+          sqe.fd        = fileFD;
+          sqe.off       = slot.chunk.offset;
+          sqe.addr      = (uint64_t)&slot.iov;
+          sqe.len       = 1;
+          sqe.user_data = slotID;
+          sqArray[index] = index;
+          tail++;
+          numInFlight++;
+          numUnsubmitted++;
+        }
+        __atomic_store_n(sqTail,tail,__ATOMIC_RELEASE);
+
+        if (!enterFailed) {
+          int numSubmitted = (int)syscall(__NR_io_uring_enter,fd,numUnsubmitted,1,
+                                          IORING_ENTER_GETEVENTS,nullptr,0);
+          if (numSubmitted >= 0)
+            numUnsubmitted -= numSubmitted;
+          else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            if (error.empty())
+              error = std::string("io_uring_enter failed: ")+strerror(errno);
+            /* whatever the kernel didn't take it never will; take it
+               back out of the ring */
+            const unsigned kernelHead = __atomic_load_n(sqHead,__ATOMIC_ACQUIRE);
+            numInFlight -= tail-kernelHead;
+            numUnsubmitted = 0;
+            __atomic_store_n(sqTail,kernelHead,__ATOMIC_RELEASE);
+            enterFailed = broken = true;
+          }
+          /* on EBUSY the completion queue is full, so (as for all
+             other cases) reap what completed before trying again */
+        }
+
+        unsigned head = *cqHead;
+        const unsigned cqEnd = __atomic_load_n(cqTail,__ATOMIC_ACQUIRE);
+        if (enterFailed && head == cqEnd && numInFlight > 0)
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        for (;head != cqEnd;head++) {
+          const io_uring_cqe &cqe = cqes[head & cqMask];
+          const unsigned slotID = (unsigned)cqe.user_data;
+          const int      result = cqe.res;
+          const Chunk    chunk  = slots[slotID].chunk;
+          freeSlots.push_back(slotID);
+          numInFlight--;
+          if (result == -EINTR || result == -EAGAIN)
+            todo.push_back(chunk);
+          else if (result < 0)
+            error = strerror(-result);
+          else if (result == 0)
+            error = "partial read";
+          else if ((size_t)result < chunk.size)
+            todo.push_back({chunk.offset+result,chunk.data+result,
+                            chunk.size-result});
+        }
+        __atomic_store_n(cqHead,head,__ATOMIC_RELEASE);
+      }
+      if (!error.empty())
+        throw std::runtime_error("error reading file: "+error);
+    }
+#endif
+    
+    ReadQueue::ReadQueue(PositionalReadFile::SP file, Backend backend)
+      : file(file), backend(backend)
+    {
+      if (backend == SERIAL) return;
+#if MINI_HAVE_IO_URING
+      if (backend == AUTO || backend == IO_URING) {
+        if (Ring::forThisThread()) {
+          this->backend = IO_URING;
+          return;
+        }
+        /* fall back to the thread pool */
+      }
+#endif
+      this->backend = THREAD_POOL;
+    }
+    
+    void ReadQueue::read(size_t offset, void *data, size_t numBytes)
+    {
+      if (numBytes <= CHUNK_SIZE || backend == SERIAL) {
+        readFully(*file,offset,data,numBytes);
+        return;
+      }
+#if MINI_HAVE_IO_URING
+      if (backend == IO_URING) {
+        /* queues get used from whichever thread reads through them,
+           so look up that thread's ring on every read */
+        if (Ring *ring = Ring::forThisThread()) {
+          ring->read(file->fd,offset,(char *)data,numBytes);
+          return;
+        }
+      }
+#endif
+      readOnThreads(*file,offset,(char *)data,numBytes);
+    }
+
+    const char *ReadQueue::toString(Backend backend)
+    {
+      switch (backend) {
+      case AUTO:        return "auto";
+      case IO_URING:    return "io_uring";
+      case THREAD_POOL: return "thread pool";
+      case SERIAL:      return "serial";
+      }
+      return "<invalid>";
+    }
+
+    /*! size of the buffer that small reads from a
+        PositionalReadBuffer get served from; reads larger than that
+        go straight to the file */
+    const size_t readBufferSize = 1<<16;
+    
+    PositionalReadBuffer::PositionalReadBuffer(PositionalReadFile::SP file,
+                                               ReadQueue::Backend backend,
+                                               size_t offset)
+      : queue(file,backend), offset(offset)
+    {
+      buffer.resize(readBufferSize);
+      setg(buffer.data(),buffer.data(),buffer.data());
+    }
+
+    PositionalReadBuffer::int_type PositionalReadBuffer::underflow()
+    {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+      offset = tell();
+      size_t numRead = 0;
+      try {
+        numRead = queue.file->read(offset,buffer.data(),buffer.size());
+      } catch (...) {
+      }
+      setg(buffer.data(),buffer.data(),buffer.data()+numRead);
+      return numRead ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+    }
+    
+    std::streamsize PositionalReadBuffer::xsgetn(char *s, std::streamsize n)
+    {
+      size_t numDone = std::min((size_t)n,(size_t)(egptr()-gptr()));
+      memcpy(s,gptr(),numDone);
+      gbump((int)numDone);
+      const size_t numLeft = n-numDone;
+      if (numLeft == 0)
+        return n;
+
+      if (numLeft < buffer.size()) {
+        if (traits_type::eq_int_type(underflow(),traits_type::eof()))
+          return numDone;
+        const size_t numMore = std::min(numLeft,(size_t)(egptr()-gptr()));
+        memcpy(s+numDone,gptr(),numMore);
+        gbump((int)numMore);
+        return numDone+numMore;
+      }
+      
+      const size_t pos = tell();
+      try {
+        queue.read(pos,s+numDone,numLeft);
+      } catch (...) {
+        return numDone;
+      }
+      offset = pos+numLeft;
+      setg(buffer.data(),buffer.data(),buffer.data());
+      return n;
+    }
+
+    PositionalReadBuffer::pos_type
+    PositionalReadBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+                                  std::ios_base::openmode which)
+    {
+      if (dir == std::ios_base::cur) {
+        if (off == 0) return pos_type(tell());
+        return seekpos(pos_type(tell()+off),which);
+      }
+      if (dir == std::ios_base::end)
+        return seekpos(pos_type(queue.file->size+off),which);
+      return seekpos(pos_type(off),which);
+    }
+    
+    PositionalReadBuffer::pos_type
+    PositionalReadBuffer::seekpos(pos_type pos, std::ios_base::openmode)
+    {
+      if (off_type(pos) < 0)
+        return pos_type(-1);
+      const size_t target = (size_t)off_type(pos);
+      if (target >= offset && target <= offset+(egptr()-eback())) {
+        /* still within what's buffered */
+        setg(eback(),eback()+(target-offset),egptr());
+      } else {
+        offset = target;
+        setg(buffer.data(),buffer.data(),buffer.data());
+      }
+      return pos;
+    }
+    
+  } // ::mini::io
+} // ::mini
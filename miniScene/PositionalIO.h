@@ -0,0 +1,270 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+// std
+#include <streambuf>
+#include <ostream>
+#include <fstream>
+#include <memory>
+
+namespace mini {
+  namespace io {
+
+    /*! a stream buffer that does not write anything, but only counts
+        how many bytes would have been written; used to compute the
+        size of records before writing them. tellp() on a stream using
+        this buffer returns the position the bytes would have been
+        written to */
+    struct CountingBuffer : public std::streambuf {
+      CountingBuffer(size_t offset=0) : pos(offset) {}
+
+    protected:
+      std::streamsize xsputn(const char *, std::streamsize n) override
+      { pos += n; return n; }
+      
+      int_type overflow(int_type c) override
+      { pos++; return traits_type::not_eof(c); }
+      
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                       std::ios_base::openmode) override
+      { return (off == 0 && dir == std::ios_base::cur) ? pos_type(pos) : pos_type(-1); }
+
+    public:
+      size_t pos;
+    };
+
+    /*! a stream buffer that passes everything written to it on to
+        another stream buffer, and keeps track of the position itself
+        - so tellp() works even where the target can't tell (pipes,
+        terminals, ...) */
+    struct PositionTrackingBuffer : public std::streambuf {
+      PositionTrackingBuffer(std::streambuf *target) : target(target) {}
+
+    protected:
+      std::streamsize xsputn(const char *s, std::streamsize n) override
+      {
+        const std::streamsize written = target->sputn(s,n);
+        if (written > 0) pos += written;
+        return written;
+      }
+      
+      int_type overflow(int_type c) override
+      {
+        if (traits_type::eq_int_type(c,traits_type::eof()))
+          return traits_type::not_eof(c);
+        const char ch = traits_type::to_char_type(c);
+        return xsputn(&ch,1) == 1 ? c : traits_type::eof();
+      }
+
+      int sync() override
+      { return target->pubsync(); }
+      
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                       std::ios_base::openmode) override
+      { return (off == 0 && dir == std::ios_base::cur) ? pos_type(pos) : pos_type(-1); }
+
+    private:
+      std::streambuf *const target;
+      size_t pos { 0 };
+    };
+
+    /*! marks a file as being read from, for as long as this object
+        lives. PositionalReadFile's (and so, the pagers of paged
+        meshes) and MappedFile's hold one of these, so saving a scene
+        can tell whether it would overwrite a file that some paged
+        mesh or memory-mapped array still reads from. Files are
+        identified by device and inode, so all paths to a file
+        (through symlinks or hard links) count as that file */
+    struct FileInUse {
+      typedef std::shared_ptr<FileInUse> SP;
+      
+      FileInUse(uint64_t device, uint64_t inode);
+      ~FileInUse();
+
+      /*! whether the file at the given path is in use; always false
+          if there is no such file, and on platforms without inodes */
+      static bool isInUse(const std::string &fileName);
+      
+    private:
+      const uint64_t device, inode;
+    };
+
+    /*! returns the path of the file that the given path refers to,
+        with all symlinks resolved; returns 'fileName' itself if
+        there is no such file (or on platforms without symlinks) */
+    std::string resolveSymlinks(const std::string &fileName);
+
+    /*! gives file 'to' the permissions of file 'from' (as far as
+        possible; this never throws) */
+    void copyPermissions(const std::string &from, const std::string &to);
+    
+    /*! a file opened for positional writes, so that multiple threads
+        can write to different regions of the same file concurrently
+        (using pwrite on posix systems) */
+    struct PositionalFile {
+      PositionalFile(const std::string &fileName);
+      ~PositionalFile();
+      
+      /*! writes given bytes at given offset; throws on error */
+      void write(size_t offset, const void *data, size_t numBytes);
+
+      /*! sets the file to the given size */
+      void resize(size_t size);
+
+      /*! whether this platform supports concurrent positional
+          writes; if not, write() is still available, but serialized */
+      static bool supportsConcurrentWrites();
+      
+    private:
+      const std::string fileName;
+#ifdef _WIN32
+      std::mutex    mutex;
+      std::fstream *file { nullptr };
+#else
+      int fd { -1 };
+#endif
+    };
+    
+    /*! a stream buffer that writes everything to a PositionalFile,
+        starting at a given offset. Small writes get buffered, large
+        ones go straight to the file */
+    struct PositionalWriteBuffer : public std::streambuf {
+      PositionalWriteBuffer(PositionalFile &file, size_t offset);
+      ~PositionalWriteBuffer();
+
+    protected:
+      std::streamsize xsputn(const char *s, std::streamsize n) override;
+      int_type overflow(int_type c) override;
+      int sync() override;
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                       std::ios_base::openmode) override;
+
+    private:
+      /*! writes out whatever is currently buffered */
+      bool flushBuffer();
+      
+      PositionalFile   &file;
+      /*! file offset of the first byte in the buffer */
+      size_t            offset;
+      std::vector<char> buffer;
+    };
+    
+    /*! a file opened for positional reads, so that multiple threads
+        can read from different regions of the same file
+        concurrently (using pread on posix systems) */
+    struct PositionalReadFile {
+      typedef std::shared_ptr<PositionalReadFile> SP;
+      
+      PositionalReadFile(const std::string &fileName);
+      ~PositionalReadFile();
+
+      /*! reads up to given number of bytes at given offset; returns
+          the number of bytes read, which is less than requested only
+          at the end of the file. Throws on error */
+      size_t read(size_t offset, void *data, size_t numBytes);
+
+      /*! size of the file, in bytes */
+      size_t size { 0 };
+      
+      const std::string fileName;
+    private:
+      friend struct ReadQueue;
+#ifdef _WIN32
+      std::mutex    mutex;
+      std::fstream *file { nullptr };
+#else
+      int fd { -1 };
+      FileInUse::SP inUse;
+#endif
+    };
+
+    /*! reads large ranges of a PositionalReadFile by splitting them
+        into chunks, and keeping many of those chunks in flight at
+        the same time - either through an io_uring (on linux
+        systems that allow for it; each thread sets up one on its
+        first read and keeps reusing it), or through a pool of
+        threads doing blocking positional reads. Each chunk gets
+        read straight into its part of the destination memory. A
+        queue may only be used by one thread at a time */
+    struct ReadQueue {
+      typedef enum {
+        /*! io_uring if available, THREAD_POOL otherwise */
+        AUTO=0,
+        IO_URING,
+        THREAD_POOL,
+        /*! no queue at all - one blocking read after another */
+        SERIAL
+      } Backend;
+
+      enum {
+        CHUNK_SIZE  = 1<<19,
+        QUEUE_DEPTH = 32
+      };
+      
+      /*! creates a queue for the given file; if the requested backend
+          is not available, falls back to THREAD_POOL (see
+          'backend' for which one is actually used) */
+      ReadQueue(PositionalReadFile::SP file, Backend backend=AUTO);
+
+      /*! reads the given number of bytes at given offset, and blocks
+          until all of them have arrived; throws on error, or if the
+          file ends before */
+      void read(size_t offset, void *data, size_t numBytes);
+
+      static const char *toString(Backend backend);
+      
+      const PositionalReadFile::SP file;
+      /*! backend that this queue actually uses */
+      Backend backend;
+      
+    private:
+      /*! an io_uring; each thread has (at most) one, shared by all
+          queues it reads through */
+      struct Ring;
+    };
+    
+    /*! a stream buffer that reads from a PositionalReadFile; small
+        reads get served from a buffer, large ones (the payload of
+        mesh arrays, texels, ...) go through a ReadQueue straight
+        into the memory they get read into. Allows for reading the
+        same file through many streams concurrently, one per thread */
+    struct PositionalReadBuffer : public std::streambuf {
+      PositionalReadBuffer(PositionalReadFile::SP file,
+                           ReadQueue::Backend backend=ReadQueue::AUTO,
+                           size_t offset=0);
+
+    protected:
+      int_type underflow() override;
+      std::streamsize xsgetn(char *s, std::streamsize n) override;
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                       std::ios_base::openmode) override;
+      pos_type seekpos(pos_type pos, std::ios_base::openmode) override;
+      
+    private:
+      /*! file offset of the next byte to be read */
+      size_t tell() const { return offset+(gptr()-eback()); }
+      
+      ReadQueue         queue;
+      /*! file offset of the first byte in the buffer */
+      size_t            offset;
+      std::vector<char> buffer;
+    };
+    
+  } // ::mini::io
+} // ::mini
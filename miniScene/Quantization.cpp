@@ -0,0 +1,143 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Quantization.h"
+#include <mutex>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+namespace mini {
+
+  /*! number of vertices processed by one parallel task */
+  enum { VERTICES_PER_TASK = 16*1024 };
+  
+  QuantizedPositions::SP QuantizedPositions::encode(const Array<vec3f> &positions,
+                                                    int bits)
+  {
+    if (bits < 1 || bits > MAX_BITS)
+      throw std::runtime_error("invalid number of bits for position quantization ("
+                               +std::to_string(bits)+")");
+    QuantizedPositions::SP qp = std::make_shared<QuantizedPositions>();
+    qp->bits = bits;
+
+    const size_t N = positions.size();
+    if (bits <= MAX_NARROW_BITS)
+      qp->narrow.resize(3*N);
+    else
+      qp->wide.resize(N);
+    if (N == 0)
+      return qp;
+    
+    box3f bounds;
+    for (auto pos : positions)
+      bounds.extend(pos);
+    
+    const float maxQ = float((1u<<bits)-1);
+    const vec3f extent = bounds.upper - bounds.lower;
+    qp->lower = bounds.lower;
+    qp->scale = extent * (1.f/maxQ);
+    const vec3f invScale(extent.x > 0.f ? maxQ/extent.x : 0.f,
+                         extent.y > 0.f ? maxQ/extent.y : 0.f,
+                         extent.z > 0.f ? maxQ/extent.z : 0.f);
+    
+    std::mutex mutex;
+    parallel_for_blocked(0,N,VERTICES_PER_TASK,[&](size_t begin, size_t end){
+        float maxError = 0.f;
+        for (size_t i=begin;i<end;i++) {
+          const vec3f pos = positions[i];
+          uint32_t q[3];
+          for (int d=0;d<3;d++) {
+            float f = (pos[d]-qp->lower[d])*invScale[d]+.5f;
+            q[d] = uint32_t(std::min(std::max(f,0.f),maxQ));
+            float decoded = qp->lower[d]+float(q[d])*qp->scale[d];
+            maxError = std::max(maxError,fabsf(decoded-pos[d]));
+          }
+          if (bits <= MAX_NARROW_BITS) {
+            qp->narrow[3*i+0] = uint16_t(q[0]);
+            qp->narrow[3*i+1] = uint16_t(q[1]);
+            qp->narrow[3*i+2] = uint16_t(q[2]);
+          } else
+            qp->wide[i]
+              = (uint64_t(q[0]))
+              | (uint64_t(q[1]) << MAX_BITS)
+              | (uint64_t(q[2]) << (2*MAX_BITS));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        qp->maxError = std::max(qp->maxError,maxError);
+      });
+    return qp;
+  }
+
+  /*! decodes vertices [begin,end) of a narrow encoding. With SSE, does
+      four vertices - ie, twelve coordinates, or three SIMD vectors -
+      at a time; the per-coordinate lower/scale values then repeat
+      every three vectors */
+  static void decodeNarrow(const uint16_t *in, float *out,
+                           size_t begin, size_t end,
+                           const vec3f &lower, const vec3f &scale)
+  {
+    size_t i = begin;
+#ifdef __SSE2__
+    const __m128 scale0 = _mm_setr_ps(scale.x,scale.y,scale.z,scale.x);
+    const __m128 scale1 = _mm_setr_ps(scale.y,scale.z,scale.x,scale.y);
+    const __m128 scale2 = _mm_setr_ps(scale.z,scale.x,scale.y,scale.z);
+    const __m128 lower0 = _mm_setr_ps(lower.x,lower.y,lower.z,lower.x);
+    const __m128 lower1 = _mm_setr_ps(lower.y,lower.z,lower.x,lower.y);
+    const __m128 lower2 = _mm_setr_ps(lower.z,lower.x,lower.y,lower.z);
+    const __m128i zero  = _mm_setzero_si128();
+    for (;i+4<=end;i+=4) {
+      const uint16_t *q = in+3*i;
+      float          *f = out+3*i;
+      __m128i q0 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(q+0)),zero);
+      __m128i q1 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(q+4)),zero);
+      __m128i q2 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(q+8)),zero);
+      _mm_storeu_ps(f+0,_mm_add_ps(lower0,_mm_mul_ps(_mm_cvtepi32_ps(q0),scale0)));
+      _mm_storeu_ps(f+4,_mm_add_ps(lower1,_mm_mul_ps(_mm_cvtepi32_ps(q1),scale1)));
+      _mm_storeu_ps(f+8,_mm_add_ps(lower2,_mm_mul_ps(_mm_cvtepi32_ps(q2),scale2)));
+    }
+#endif
+    for (;i<end;i++)
+      for (int d=0;d<3;d++)
+        out[3*i+d] = lower[d]+float(in[3*i+d])*scale[d];
+  }
+  
+  void QuantizedPositions::decode(Array<vec3f> &positions) const
+  {
+    const size_t N = numVertices();
+    positions.clear();
+    positions.resize(N);
+    if (bits <= MAX_NARROW_BITS) {
+      const uint16_t *in  = narrow.data();
+      float          *out = (float*)positions.data();
+      parallel_for_blocked(0,N,VERTICES_PER_TASK,[&](size_t begin, size_t end){
+          decodeNarrow(in,out,begin,end,lower,scale);
+        });
+    } else {
+      const uint64_t mask = (uint64_t(1) << MAX_BITS)-1;
+      parallel_for_blocked(0,N,VERTICES_PER_TASK,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const uint64_t q = wide[i];
+            positions[i]
+              = lower + vec3f(float(q & mask),
+                              float((q >> MAX_BITS) & mask),
+                              float((q >> (2*MAX_BITS)) & mask)) * scale;
+          }
+        });
+    }
+  }
+  
+} // ::mini
@@ -0,0 +1,55 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Array.h"
+
+namespace mini {
+
+  /*! vertex positions quantized relative to their bounding box: each
+      coordinate is stored as a 'bits'-bit integer q, and decodes to
+      lower + q*scale. Up to 16 bits, each coordinate is a uint16_t
+      (6 bytes per vertex); up to 21 bits, all three coordinates get
+      packed into one uint64_t (8 bytes per vertex) */
+  struct QuantizedPositions {
+    typedef std::shared_ptr<QuantizedPositions> SP;
+
+    enum { MAX_NARROW_BITS = 16, MAX_BITS = 21 };
+
+    /*! quantizes given positions with given number of bits (1 to
+        MAX_BITS) per coordinate */
+    static SP encode(const Array<vec3f> &positions, int bits);
+
+    /*! decodes into given array (which gets resized as required) */
+    void decode(Array<vec3f> &positions) const;
+
+    size_t numVertices() const
+    { return bits <= MAX_NARROW_BITS ? narrow.size()/3 : wide.size(); }
+    
+    int    bits     { 0 };
+    vec3f  lower    { 0.f };
+    vec3f  scale    { 0.f };
+    /*! largest difference, in any coordinate, between an original
+        and a decoded position */
+    float  maxError { 0.f };
+    /*! three values per vertex, for bits <= MAX_NARROW_BITS */
+    Array<uint16_t> narrow;
+    /*! one value per vertex (x in the low bits), for more bits */
+    Array<uint64_t> wide;
+  };
+  
+} // ::mini
@@ -16,15 +16,20 @@
 
 #include "miniScene/Scene.h"
 #include "miniScene/Serialized.h"
-#include "miniScene/IO.h"
+#include "miniScene/FileFormat.h"
+#include "miniScene/PositionalIO.h"
+#include "miniScene/MeshPager.h"
+#include "miniScene/SceneReader.h"
+#include "miniScene/AsyncLoad.h"
+#include "miniScene/Bounds.h"
+#include "miniScene/Arena.h"
 #include <sstream>
+#include <functional>
+#include <chrono>
+#include <cstdio>
 
 namespace mini {
 
-  enum { FORMAT_VERSION = 11 };
-    
-  const size_t expected_magic = 4321000000ULL+FORMAT_VERSION;
-
   std::string DirLight::toString()
   {
     std::stringstream ss;
@@ -32,224 +37,592 @@ namespace mini {
     return ss.str();
   }
   
+  Mesh::~Mesh()
+  {
+    if (paging.pager) paging.pager->forget(this);
+  }
+  
+  size_t Mesh::getNumPrims() const
+  {
+    if (isPaged()) return paging.numPrims;
+    return indices16.empty() ? indices.size() : indices16.size();
+  }
+
+  bool Mesh::canCompactIndices() const
+  {
+    if (!indices16.empty())
+      return true;
+    /* negative indices become large ones */
+    uint32_t maxIndex = 0;
+    for (auto &tri : indices)
+      maxIndex = std::max(maxIndex,std::max(uint32_t(tri.x),
+                                            std::max(uint32_t(tri.y),uint32_t(tri.z))));
+    return maxIndex <= 0xffffu;
+  }
+
+  bool Mesh::compactIndices()
+  {
+    if (!indices16.empty())
+      return true;
+    if (indices.empty() || !canCompactIndices())
+      return false;
+    indices16.resize(indices.size());
+    for (size_t i=0;i<indices.size();i++)
+      indices16[i] = vec3us(indices[i]);
+    indices = Array<vec3i>();
+    return true;
+  }
+
+  void Mesh::expandIndices()
+  {
+    if (indices16.empty())
+      return;
+    indices.resize(indices16.size());
+    for (size_t i=0;i<indices16.size();i++)
+      indices[i] = vec3i(indices16[i]);
+    indices16 = Array<vec3us>();
+  }
+  
+  size_t Mesh::getNumVertices() const
+  {
+    return isPaged() ? paging.numVertices : vertices.size();
+  }
+
+  void Mesh::makeResident()
+  {
+    if (paging.pager) paging.pager->makeResident(this);
+  }
+  
+  void Mesh::release()
+  {
+    if (paging.pager) paging.pager->release(this);
+  }
+  
+  /*! incremented every time any mesh's bounds change; object
+      bounds are cached for a given value of this */
+  static std::atomic<uint64_t> meshBoundsVersion { 0 };
+  
   box3f Mesh::getBounds() const
   {
-    box3f bounds;
-    for (auto vtx : vertices)
-      bounds.extend(vtx);
-    return bounds;
+    if (isPaged())
+      return paging.bounds;
+
+    return cachedBounds.get(0,[this](){
+        return parallelComputeBounds(vertices.data(),vertices.size());
+      });
+  }
+
+  void Mesh::markDirty()
+  {
+    cachedBounds.invalidate();
+    meshBoundsVersion++;
   }
     
   box3f Object::getBounds() const
   {
-    box3f bounds;
-    for (auto mesh : meshes)
-      bounds.extend(mesh->getBounds());
-    return bounds;
+    return cachedBounds.get(meshBoundsVersion.load(),[this](){
+        box3f bounds;
+        for (auto mesh : meshes)
+          if (mesh) bounds.extend(mesh->getBounds());
+        return bounds;
+      });
   }
     
   box3f Instance::getBounds() const
   {
-    box3f bounds;
+    if (!object)
+      return box3f();
     box3f box = object->getBounds();
-    for (int i=0;i<8;i++) {
-      vec3f corner((i&1?box.lower:box.upper).x,
-                   (i&1?box.lower:box.upper).y,
-                   (i&1?box.lower:box.upper).z);
-      bounds.extend(xfmPoint(xfm,corner));
+    if (box.empty())
+      return box;
+    return xfmBox(xfm,box);
+  }
+  
+  bool InstanceTable::isDense() const
+  {
+    for (size_t i=0;i<size()/64;i++)
+      if (~valid[i]) return false;
+    for (size_t instID=size()/64*64;instID<size();instID++)
+      if (!isValid(instID)) return false;
+    for (auto objectID : objectIDs)
+      if (objectID == NO_OBJECT) return false;
+    return true;
+  }
+  
+  void InstanceTable::push_back(const affine3f &xfm, uint32_t objectID, bool isValid)
+  {
+    const size_t instID = size();
+    if (instID % 64 == 0)
+      valid.push_back(0);
+    if (isValid)
+      valid.back() |= uint64_t(1) << (instID%64);
+    transforms.push_back(xfm);
+    objectIDs.push_back(objectID);
+  }
+  
+  InstanceTable::SP Scene::getInstanceTable() const
+  {
+    /* changes to existing instances have to be reported through
+       markInstancesDirty(), but added or removed ones we notice */
+    if (instanceTable && instanceTable->size() == instances.size())
+      return instanceTable;
+    
+    InstanceTable::SP table = std::make_shared<InstanceTable>();
+    Serialized<Object::SP> objects;
+    table->transforms.reserve(instances.size());
+    table->objectIDs.reserve(instances.size());
+    table->valid.reserve((instances.size()+63)/64);
+    for (auto &inst : instances) {
+      if (!inst)
+        table->push_back(affine3f(),InstanceTable::NO_OBJECT,false);
+      else if (!inst->object)
+        table->push_back(inst->xfm,InstanceTable::NO_OBJECT);
+      else {
+        objects.add(inst->object);
+        table->push_back(inst->xfm,(uint32_t)objects.getID(inst->object));
+      }
     }
-    return bounds;
+    table->objects = objects.list;
+    return table;
   }
+  
   box3f Scene::getBounds() const
   {
+    /* each task gathers the transforms and object bounds of a range
+       of instances, and hands those to the box kernel in one go */
+    const size_t instancesPerTask = 4*1024;
+    std::vector<box3f> taskBounds((instances.size()+instancesPerTask-1)/instancesPerTask);
+    parallel_for_blocked(0,instances.size(),instancesPerTask,
+                         [&](size_t begin, size_t end){
+        std::vector<affine3f> xfms;
+        std::vector<box3f>    boxes;
+        xfms.reserve(end-begin);
+        boxes.reserve(end-begin);
+        for (size_t instID=begin;instID<end;instID++) {
+          const Instance *inst = instances[instID].get();
+          if (!inst || !inst->object) continue;
+          box3f box = inst->object->getBounds();
+          if (box.empty()) continue;
+          xfms.push_back(inst->xfm);
+          boxes.push_back(box);
+        }
+        taskBounds[begin/instancesPerTask]
+          = computeBounds(xfms.data(),boxes.data(),xfms.size());
+      });
     box3f bounds;
-    for (auto inst : instances)
-      bounds.extend(inst->getBounds());
+    for (auto &box : taskBounds)
+      bounds.extend(box);
     return bounds;
   }
     
     
-  void Scene::save(const std::string &baseName)
+  /*! computes counts and bounds of all meshes of given serialized
+      scene, in parallel; leaves the infos' material IDs untouched */
+  static void computeMeshInfos(const SerializedScene &serialized,
+                               std::vector<TOC::MeshInfo> &infos)
+  {
+    infos.resize(serialized.meshes.size());
+    parallel_for(serialized.meshes.size(),[&](size_t meshID){
+        Mesh::SP mesh = serialized.meshes[meshID];
+        TOC::MeshInfo &info = infos[meshID];
+        info.numPrims    = mesh->getNumPrims();
+        info.numVertices = mesh->getNumVertices();
+        info.bounds      = mesh->getBounds();
+      });
+  }
+
+  /*! computes the summary of a scene, given that scene's serialized
+      form and mesh infos */
+  static SceneInfo computeInfo(const Scene *scene,
+                               SerializedScene &serialized,
+                               const std::vector<TOC::MeshInfo> &meshInfos)
+  {
+    SceneInfoBuilder builder;
+    for (auto tex : serialized.textures.list)
+      if (tex) builder.addTexture(*tex);
+    builder.setLights(scene->quadLights,scene->dirLights,scene->envMapLight);
+    for (auto object : serialized.objects.list) {
+      std::vector<int> meshIDs;
+      for (auto mesh : object->meshes)
+        meshIDs.push_back(mesh ? serialized.getID(mesh) : -1);
+      builder.addObject(meshIDs);
+    }
+    for (auto inst : scene->instances)
+      if (inst)
+        builder.addInstance(inst->xfm,serialized.getID(inst->object));
+      else
+        builder.addInstance(affine3f(),-1);
+    return builder.finish(meshInfos,serialized.materials.size());
+  }
+
+  SceneInfo Scene::getInfo() const
   {
-    std::ofstream out(baseName,std::ios::binary);
-    if (!out.good())
-      throw std::runtime_error("could not open file '"+baseName+"'");
     SerializedScene serialized(this);
-      
-    io::writeElement(out,expected_magic);
+    std::vector<TOC::MeshInfo> meshInfos;
+    computeMeshInfos(serialized,meshInfos);
+    return computeInfo(this,serialized,meshInfos);
+  }
+  
+  size_t Scene::dedupMaterials()
+  {
+    SerializedScene serialized(this);
+    size_t numFolded = serialized.dedupMaterials();
+    for (auto mesh : serialized.meshes.list)
+      mesh->material = serialized.materials[serialized.getID(mesh->material)];
+    return numFolded;
+  }
+  
+  /*! one record of a file that's about to be written: a function
+      that writes that record to a stream, and - once known - where
+      in the file this record ended up */
+  struct SaveRecord {
+    std::function<void(std::ostream &)> write;
+    /*! where this record goes, and (once written) its checksum */
+    TOC::Chunk  placement;
+    /*! where in the TOC this record's chunk goes */
+    TOC::Chunk *tocEntry { nullptr };
+  };
+
+  /*! everything required to write a given scene to disk: the
+      serialized scene, and the list of records to write, in the
+      order they'll appear in the file. Both serial and parallel
+      saving write exactly these records, so they produce the exact
+      same file */
+  struct SaveJob {
+    SaveJob(Scene *scene, const SaveOptions &options);
+
+    /*! applies the job's format options to a stream records get
+        written to */
+    void setUp(std::ostream &out) const
+    {
+      io::alignArrays(out)    = (toc.formatFlags & FORMAT_FLAG_ALIGNED_ARRAYS) != 0;
+      io::compressArrays(out) = (toc.formatFlags & FORMAT_FLAG_COMPRESSED_ARRAYS) != 0;
+    }
+
+    /*! computes each record's placement in the file by 'writing' all
+        records to a stream that only counts bytes; returns the offset
+        at which the TOC will go. Note that with compressed arrays,
+        this compresses everything once just to learn its size */
+    size_t computePlacements();
+
+    /*! encodes all meshes (as far as the options ask for that) up
+        front, rather than each one only while writing it. For
+        saveParallel(), which writes every record twice; note this
+        keeps all encodings alive until the job is done */
+    void encodeMeshes();
+    
+    void addRecord(const std::function<void(std::ostream &)> &write,
+                   TOC::Chunk *tocEntry=nullptr)
+    {
+      SaveRecord record;
+      record.write    = write;
+      record.tocEntry = tocEntry;
+      records.push_back(record);
+    }
+    
+    void setTOCEntries()
+    {
+      for (auto &record : records)
+        if (record.tocEntry) *record.tocEntry = record.placement;
+    }
+    
+    const SaveOptions       options;
+    SerializedScene         serialized;
+    /*! per mesh, the encoding that encodeMeshes() computed (if it
+        got called) */
+    std::vector<MeshEncoding> encodings;
+    SaveStats               stats;
+    TOC                     toc;
+    std::vector<SaveRecord> records;
+  };
+
+  SaveJob::SaveJob(Scene *scene, const SaveOptions &options)
+    : options(options), serialized(scene)
+  {
+    stats.numDedupedTextures     = serialized.numDedupedTextures;
+    stats.numDedupedTextureBytes = serialized.numDedupedTextureBytes;
+    if (options.dedupMaterials)
+      stats.numDedupedMaterials = serialized.dedupMaterials();
+    if (options.dedupMeshes) {
+      const size_t numMeshes = serialized.meshes.size();
+      stats.numDedupedMeshBytes = serialized.dedupMeshes();
+      stats.numDedupedMeshes    = numMeshes - serialized.meshes.size();
+    }
+    
+    if (options.alignArrays)
+      toc.formatFlags |= FORMAT_FLAG_ALIGNED_ARRAYS;
+    if (options.compressArrays)
+      toc.formatFlags |= FORMAT_FLAG_COMPRESSED_ARRAYS;
+
+    toc.textures.resize(serialized.textures.size());
+    toc.meshes.resize(serialized.meshes.size());
+    toc.meshInfos.resize(serialized.meshes.size());
+    toc.objects.resize(serialized.objects.size());
+
+    // ------------------------------------------------------------------
+    // header
+    // ------------------------------------------------------------------
+    const size_t formatFlags = toc.formatFlags;
+    addRecord([=](std::ostream &out){
+          io::writeElement(out,magicForVersion(FORMAT_VERSION));
+          io::writeElement(out,formatFlags);
+        },&toc.header);
 
     // ------------------------------------------------------------------
     // textures
     // ------------------------------------------------------------------
-    io::writeElement(out,serialized.textures.list.size());
-    for (auto tex : serialized.textures.list) {
-      if (/* only first one may/will be null */!tex) {
-        io::writeElement(out,int(0));
-      } else {
-        io::writeElement(out,int(1));
-        io::writeElement(out,tex->size);
-        io::writeElement(out,tex->format);
-        io::writeVector(out,tex->data);
-      }
+    for (size_t texID=0;texID<serialized.textures.size();texID++) {
+      Texture::SP tex = serialized.textures[texID];
+      addRecord([=](std::ostream &out){
+            io::writeTexture(out,tex);
+          },&toc.textures[texID]);
     }
 
     // ------------------------------------------------------------------
     // lights
     // ------------------------------------------------------------------
-    io::writeVector(out,quadLights);
-    io::writeVector(out,dirLights);
-    if (envMapLight) {
-      io::writeElement(out,int(1));
-      io::writeElement(out,envMapLight->transform);
-      Texture::SP tex = envMapLight->texture;
-      assert(tex);
-      io::writeElement(out,tex->size);
-      io::writeElement(out,tex->format);
-      io::writeVector(out,tex->data);
-    } else
-      io::writeElement(out,int(0));
+    addRecord([=](std::ostream &out){
+          io::writeLights(out,scene);
+        },&toc.lights);
         
     // ------------------------------------------------------------------
     // materials
     // ------------------------------------------------------------------
-    io::writeElement(out,serialized.materials.list.size());
-    for (auto mat : serialized.materials.list) {
-      // io::writeElement(out,(MaterialData&)*mat);
-
-      io::writeElement(out,mat->emission);
-      io::writeElement(out,mat->baseColor);
-      io::writeElement(out,mat->metallic);
-      io::writeElement(out,mat->roughness);
-      io::writeElement(out,mat->transmission);
-      io::writeElement(out,mat->ior);
-
-      io::writeElement(out,serialized.getID(mat->colorTexture));
-      io::writeElement(out,serialized.getID(mat->alphaTexture));
-    }
+    std::vector<Material::SP> materials = serialized.materials.list;
+    std::vector<vec2i> textureIDs;
+    for (auto mat : materials)
+      textureIDs.push_back(vec2i(serialized.getID(mat->colorTexture),
+                                 serialized.getID(mat->alphaTexture)));
+    addRecord([=](std::ostream &out){
+          io::writeElement(out,materials.size());
+          for (size_t matID=0;matID<materials.size();matID++)
+            io::writeMaterial(out,materials[matID],
+                              textureIDs[matID].x,textureIDs[matID].y);
+        },&toc.materials);
       
     // ------------------------------------------------------------------
-    // objects and meshes
+    // meshes
     // ------------------------------------------------------------------
-    io::writeElement(out,serialized.objects.size());
-    for (auto &obj : serialized.objects.list) {
-
-      io::writeElement(out,obj->meshes.size());
-      for (auto mesh : obj->meshes) {
-        if (!mesh) { io::writeElement(out,int(0)); continue; }
-
-        io::writeElement(out,int(1));
-        io::writeVector(out,mesh->indices);
-        io::writeVector(out,mesh->vertices);
-        io::writeVector(out,mesh->normals);
-        io::writeVector(out,mesh->texcoords);
-        int matID = serialized.getID(mesh->material);
-        assert(matID >= 0);
-        io::writeElement(out,matID);
-      }
+    for (size_t meshID=0;meshID<serialized.meshes.size();meshID++) {
+      Mesh::SP mesh = serialized.meshes[meshID];
+      int matID = serialized.getID(mesh->material);
+      assert(matID >= 0);
+      toc.meshInfos[meshID].materialID = matID;
+      /* unless encodeMeshes() got called, a mesh gets encoded only
+         while writing it, so only few encodings are alive at once */
+      addRecord([=](std::ostream &out){
+            Mesh::Pin pin(mesh.get());
+            if (encodings.empty())
+              io::writeMesh(out,mesh,matID,encodeForSave(*mesh,this->options));
+            else
+              io::writeMesh(out,mesh,matID,encodings[meshID]);
+          },&toc.meshes[meshID]);
+    }
+    computeMeshInfos(serialized,toc.meshInfos);
+    
+    // ------------------------------------------------------------------
+    // objects
+    // ------------------------------------------------------------------
+    for (size_t objID=0;objID<serialized.objects.size();objID++) {
+      std::vector<int> meshIDs;
+      for (auto mesh : serialized.objects[objID]->meshes)
+        meshIDs.push_back(mesh ? serialized.getID(mesh) : -1);
+      addRecord([=](std::ostream &out){
+            io::writeObject(out,meshIDs);
+          },&toc.objects[objID]);
     }
 
     // ------------------------------------------------------------------
     // instances
     // ------------------------------------------------------------------
-    io::writeElement(out,instances.size());
-    for (auto &inst : instances) {
-      if (!inst) { io::writeElement(out,int(0)); continue; }
+    InstanceTable::SP instances = scene->getInstanceTable();
+    /* the table kept from loading is shared, so remap a copy */
+    if (instances == scene->instanceTable)
+      instances = std::make_shared<InstanceTable>(*instances);
+    /* the table's object IDs are the same as the serialized ones
+       for tables built from the scene's instances, unless objects
+       got deduplicated - but not necessarily for tables kept from
+       loading (see Scene::instanceTable) */
+    for (auto &objectID : instances->objectIDs)
+      if (objectID != InstanceTable::NO_OBJECT)
+        objectID = serialized.getID(instances->objects[objectID]);
+    instances->objects.clear();
+    addRecord([=](std::ostream &out){
+          io::writeInstanceTable(out,*instances);
+        },&toc.instances);
 
-      io::writeElement(out,int(1));
-      io::writeElement(out,inst->xfm);
-      io::writeElement(out,int(serialized.getID(inst->object)));
+    toc.summary = computeInfo(scene,serialized,toc.meshInfos);
+  }
+
+  size_t SaveJob::computePlacements()
+  {
+    size_t offset = 0;
+    for (auto &record : records) {
+      io::CountingBuffer counter(offset);
+      std::ostream out(&counter);
+      setUp(out);
+      record.write(out);
+      record.placement.offset = offset;
+      record.placement.size   = counter.pos - offset;
+      offset = counter.pos;
     }
-      
-    // ------------------------------------------------------------------
-    // proxies and owner masks
-    // ------------------------------------------------------------------
-    // io::writeVector(out,proxies);
-    // io::writeVector(out,ownedOn);
+    return offset;
+  }
 
-    // ------------------------------------------------------------------
-    // wrap-up: write end-of file marker
-    // ------------------------------------------------------------------
-    io::writeElement(out,expected_magic);
-    if (!out.good())
-      throw std::runtime_error("some error happened while writing '"+baseName+"'");
+  void SaveJob::encodeMeshes()
+  {
+    if (!options.quantizePositionBits && !options.compressIndices)
+      return;
+    encodings.resize(serialized.meshes.size());
+    parallel_for(serialized.meshes.size(),[&](size_t meshID){
+        Mesh::SP mesh = serialized.meshes[meshID];
+        Mesh::Pin pin(mesh.get());
+        encodings[meshID] = encodeForSave(*mesh,options);
+      });
   }
+  
+  /*! calls write(name) to write the file 'fileName'. Usually that
+      writes the file in place, but if paged meshes or memory-mapped
+      arrays still read from that file (eg, when saving a scene over
+      the file it was loaded from), it writes to a temporary file
+      next to it, and only once that succeeded, replaces the file
+      with it - those meshes and arrays then keep reading the old
+      file. Symlinks get followed, and the new file gets the old
+      one's permissions */
+  template<typename Write>
+  void writeReplacing(const std::string &fileName, const Write &write)
+  {
+    if (!io::FileInUse::isInUse(fileName)) {
+      write(fileName);
+      return;
+    }
     
-  Scene::SP Scene::load(const std::string &baseName)
+    static std::atomic<int> numSaves { 0 };
+    const std::string target = io::resolveSymlinks(fileName);
+    const std::string tmpName
+      = target+".tmp"
+      + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+      + "_"+std::to_string(numSaves++);
+    try {
+      write(tmpName);
+    } catch (...) {
+      std::remove(tmpName.c_str());
+      throw;
+    }
+    io::copyPermissions(target,tmpName);
+    if (std::rename(tmpName.c_str(),target.c_str()) != 0) {
+      std::remove(tmpName.c_str());
+      throw std::runtime_error("could not write file '"+fileName+"'");
+    }
+  }
+  
+  SaveStats Scene::save(const std::string &baseName, const SaveOptions &options)
   {
-    std::ifstream in(baseName,std::ios::binary);
-    if (!in.good())
-      throw std::runtime_error("could not open Scene{"+baseName+"}");
-    Scene::SP scene = std::make_shared<Scene>();
+    SaveJob job(this,options);
+    writeReplacing(baseName,[&](const std::string &name){
+        std::ofstream file(name,std::ios::binary);
+        if (!file.good())
+          throw std::runtime_error("could not open file '"+baseName+"'");
+        /* record offsets come from tellp(), which the file can't
+           answer if it's a pipe */
+        io::PositionTrackingBuffer tracker(file.rdbuf());
+        std::ostream out(&tracker);
 
-    size_t magic = io::readElement<size_t>(in);
-    if (magic != expected_magic)
-      throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic) - cannot load");
+        job.setUp(out);
+        for (auto &record : job.records)
+          io::writeRecord(out,record.placement,record.write);
+        job.setTOCEntries();
       
+        // ------------------------------------------------------------------
+        // wrap-up: write table of contents and end-of file marker
+        // ------------------------------------------------------------------
+        io::writeTOC(out,job.toc);
+        out.flush();
+        file.close();
+        if (!out.good() || !file.good())
+          throw std::runtime_error("some error happened while writing '"+baseName+"'");
+      });
+    return job.stats;
+  }
+
+  SaveStats Scene::saveParallel(const std::string &fileName, const SaveOptions &options)
+  {
+    if (!io::PositionalFile::supportsConcurrentWrites())
+      return save(fileName,options);
+    
+    SaveJob job(this,options);
+    for (auto mesh : job.serialized.meshes.list)
+      if (mesh->isPaged()) {
+        /* computing the record sizes would require reading all paged
+           meshes, and writing them would then read them again */
+        return save(fileName,options);
+      }
+
+    job.encodeMeshes();
+    size_t tocOffset = job.computePlacements();
+    job.setTOCEntries();
+
+    writeReplacing(fileName,[&](const std::string &name){
+        io::PositionalFile file(name);
+        {
+          io::CountingBuffer counter(tocOffset);
+          std::ostream out(&counter);
+          io::writeTOC(out,job.toc);
+          file.resize(counter.pos);
+        }
+    
+        /* each record's checksum gets computed while writing it, so the
+           TOC can only be written once all records are */
+        parallel_for(job.records.size(),[&](size_t recordID){
+            SaveRecord &record = job.records[recordID];
+            io::PositionalWriteBuffer buffer(file,record.placement.offset);
+            std::ostream out(&buffer);
+            job.setUp(out);
+            io::writeRecord(out,record.placement,record.write);
+            out.flush();
+            if (!out.good())
+              throw std::runtime_error("some error happened while writing '"+fileName+"'");
+          });
+        job.setTOCEntries();
+    
+        io::PositionalWriteBuffer buffer(file,tocOffset);
+        std::ostream out(&buffer);
+        io::writeTOC(out,job.toc);
+        out.flush();
+        if (!out.good())
+          throw std::runtime_error("some error happened while writing '"+fileName+"'");
+      });
+    return job.stats;
+  }
+
+  /*! parses a version 11 file (which has no TOC, and can only be read
+      front to back); 'in' can be either a std::istream or a
+      io::MappedReader, and must already be past the file magic */
+  template<typename In>
+  Scene::SP loadV11(In &in)
+  {
+    Scene::SP scene = std::make_shared<Scene>();
+
     // ------------------------------------------------------------------
     // textures
     // ------------------------------------------------------------------
     std::vector<Texture::SP> textures;
     size_t numTextures = io::readElement<size_t>(in);
-    for (int i=0;i<numTextures;i++) {
-      // if (i==0)
-      //   textures.push_back(0); // first one is always 0
-      // else {
-      int valid;
-      io::readElement(in,valid);
-      if (!valid) {
-        textures.push_back({});
-      } else {
-        Texture::SP tex = std::make_shared<Texture>();
-        io::readElement(in,tex->size);
-        io::readElement(in,tex->format);
-        io::readVector(in,tex->data);
-        textures.push_back(tex);
-      }
-    }
+    for (int i=0;i<numTextures;i++)
+      textures.push_back(io::readTexture(in));
 
     // ------------------------------------------------------------------
     // lights
     // ------------------------------------------------------------------
-    io::readVector(in,scene->quadLights);
-    io::readVector(in,scene->dirLights);
-    const int hasEnvMap = io::readElement<int>(in);
-    if (hasEnvMap) {
-      scene->envMapLight = std::make_shared<EnvMapLight>();
-      io::readElement(in,scene->envMapLight->transform);
-      Texture::SP tex = scene->envMapLight->texture = std::make_shared<Texture>();
-      io::readElement(in,tex->size);
-      io::readElement(in,tex->format);
-      io::readVector(in,tex->data);
-    }
+    io::readLights(in,scene.get());
     
     // ------------------------------------------------------------------
     // materials
     // ------------------------------------------------------------------
     std::vector<Material::SP> materials;
     size_t numMaterials = io::readElement<size_t>(in);
-    for (int i=0;i<numMaterials;i++) {
-      Material::SP mat = std::make_shared<Material>();
-      // io::readElement(in,(MaterialData&)*mat);
-      io::readElement(in,mat->emission);
-      io::readElement(in,mat->baseColor);
-      io::readElement(in,mat->metallic);
-      io::readElement(in,mat->roughness);
-      io::readElement(in,mat->transmission);
-      io::readElement(in,mat->ior);
-      {
-        int texID = io::readElement<int>(in);
-        assert(texID >= 0);
-        assert(texID < textures.size());
-        mat->colorTexture = textures[texID];
-      }
-      {
-        int texID = io::readElement<int>(in);
-        assert(texID >= 0);
-        assert(texID < textures.size());
-        mat->alphaTexture = textures[texID];
-      }
-      materials.push_back(mat);
-    }
+    for (int i=0;i<numMaterials;i++)
+      materials.push_back(io::readMaterial(in,textures));
 
     // ------------------------------------------------------------------
     // objects and meshes
@@ -261,20 +634,9 @@ namespace mini {
       Object::SP object = std::make_shared<Object>();
 
       for (int meshID=0;meshID<(int)numMeshes;meshID++) {
-        int isValid = io::readElement<int>(in);
-        if (!isValid) {
-          continue;
-        }
-        Mesh::SP mesh = std::make_shared<Mesh>();
-        io::readVector(in,mesh->indices);
-        io::readVector(in,mesh->vertices);
-        io::readVector(in,mesh->normals);
-        io::readVector(in,mesh->texcoords);
-        int matID = io::readElement<int>(in);
-        assert(matID >= 0);
-        assert(matID < materials.size());
-        mesh->material = materials[matID];
-        object->meshes.push_back(mesh);
+        Mesh::SP mesh = io::readMesh(in,materials);
+        if (mesh)
+          object->meshes.push_back(mesh);
       }
       objects.push_back(object);
     }
@@ -283,28 +645,614 @@ namespace mini {
     // instances
     // ------------------------------------------------------------------
     size_t numInstances = io::readElement<size_t>(in);
-    for (int instID=0;instID<numInstances;instID++) {
-      int isValid = io::readElement<int>(in);
-      if (!isValid) {
-        scene->instances.push_back(0);
-        continue;
-      }
-      Instance::SP inst = std::make_shared<Instance>();
-      io::readElement(in,inst->xfm);
-      inst->object = objects[io::readElement<int>(in)];
-      scene->instances.push_back(inst);
-    }
+    for (int instID=0;instID<numInstances;instID++)
+      scene->instances.push_back(io::readInstance(in,objects));
 
     // ------------------------------------------------------------------
     // wrap-up
     // ------------------------------------------------------------------
-
     size_t magicAtEnd = io::readElement<size_t>(in);
-    if (magicAtEnd != expected_magic)
+    if (magicAtEnd != magicForVersion(11))
       throw std::runtime_error("incomplete or incompatible brx file - cannot load");
       
     return scene;
   }
 
+  /*! hands out independent std::ifstream's for the same file, so
+      different threads can read from that file concurrently */
+  struct StreamReaders {
+    typedef std::ifstream In;
+    
+    StreamReaders(const std::string &fileName) : fileName(fileName) {}
+
+    template<typename Lambda>
+    void withReader(const Lambda &lambda) const
+    {
+      std::ifstream in(fileName,std::ios::binary);
+      if (!in.good())
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      lambda(in);
+    }
+    
+    const std::string fileName;
+  };
+  
+  /*! hands out independent io::MappedReaders for the same mapped
+      file, so different threads can read from it concurrently */
+  struct MappedReaders {
+    typedef io::MappedReader In;
+
+    MappedReaders(MappedFile::SP file) : file(file) {}
+    
+    template<typename Lambda>
+    void withReader(const Lambda &lambda) const
+    {
+      io::MappedReader in(file);
+      lambda(in);
+    }
+    
+    const MappedFile::SP file;
+  };
+
+  /*! hands out streams that read the same file through
+      io::PositionalReadBuffers, so different threads can read from
+      that file concurrently, each with many large reads in flight */
+  struct BulkReaders {
+    typedef std::istream In;
+
+    BulkReaders(const std::string &fileName, LoadOptions::ReadMethod method)
+      : file(std::make_shared<io::PositionalReadFile>(fileName)),
+        backend(method == LoadOptions::READ_BULK_THREADS
+                ? io::ReadQueue::THREAD_POOL
+                : io::ReadQueue::AUTO)
+    {}
+    
+    template<typename Lambda>
+    void withReader(const Lambda &lambda) const
+    {
+      io::PositionalReadBuffer buffer(file,backend);
+      std::istream in(&buffer);
+      lambda(in);
+    }
+
+    const io::PositionalReadFile::SP file;
+    const io::ReadQueue::Backend     backend;
+  };
+  
+  /*! number of meshes each parallel load task reads; meshes can be
+      tiny, so one task per mesh would be too fine-grained */
+  const size_t meshesPerTask = 16;
+  
+  /*! loads the materials table, with the materials' texture IDs
+      referring to the given textures; in the given arena, if any */
+  template<typename Readers>
+  std::vector<Material::SP> loadMaterials(const Readers &readers, const TOC &toc,
+                                          const std::vector<Texture::SP> &textures,
+                                          Arena *arena = nullptr)
+  {
+    typedef typename Readers::In In;
+    
+    std::vector<Material::SP> materials;
+    readers.withReader([&](In &in){
+        io::seek(in,toc.materials.offset);
+        size_t numMaterials = io::readElement<size_t>(in);
+        for (size_t i=0;i<numMaterials;i++)
+          materials.push_back(io::readMaterial(in,textures,arena));
+      });
+    return materials;
+  }
+
+  /*! loads the materials table (and all textures it refers to) from
+      the given input, reading the textures in parallel */
+  template<typename Readers>
+  std::vector<Material::SP> loadMaterials(const Readers &readers, const TOC &toc,
+                                          Arena *arena = nullptr)
+  {
+    typedef typename Readers::In In;
+    
+    std::vector<Texture::SP> textures(toc.textures.size());
+    parallel_for(textures.size(),[&](size_t texID){
+        readers.withReader([&](In &in){
+            io::seek(in,toc.textures[texID].offset);
+            textures[texID] = io::readTexture(in);
+          });
+      });
+    return loadMaterials(readers,toc,textures,arena);
+  }
+  
+  /*! given the already loaded meshes, reads the lights, objects and
+      instances into the given scene; creating objects and instances
+      in the given arena, if any */
+  template<typename Readers>
+  void loadSceneGraph(const Readers &readers, const TOC &toc,
+                      const std::vector<Mesh::SP> &meshes,
+                      Scene *scene, Arena *arena = nullptr)
+  {
+    typedef typename Readers::In In;
+    readers.withReader([&](In &in){
+        io::seek(in,toc.lights.offset);
+        io::readLights(in,scene);
+
+        std::vector<Object::SP> objects;
+        for (auto &chunk : toc.objects) {
+          io::seek(in,chunk.offset);
+          objects.push_back(io::readObject(in,meshes,arena));
+        }
+
+        io::seek(in,toc.instances.offset);
+        scene->instanceTable = std::make_shared<InstanceTable>();
+        InstanceTable &table = *scene->instanceTable;
+        io::readInstanceTable(in,toc.formatVersion,objects.size(),table);
+        table.objects = objects;
+        scene->instances.resize(table.size());
+        if (arena) {
+          ArenaAllocator<Instance> allocator(arena->shared_from_this());
+          for (size_t instID=0;instID<table.size();instID++) {
+            if (!table.isValid(instID)) continue;
+            const uint32_t objectID = table.objectIDs[instID];
+            Instance::SP instance = allocator.make();
+            instance->xfm = table.transforms[instID];
+            if (objectID != InstanceTable::NO_OBJECT)
+              instance->object = objects[objectID];
+            scene->instances[instID] = instance;
+          }
+          return;
+        }
+        for (size_t instID=0;instID<table.size();instID++) {
+          if (!table.isValid(instID)) continue;
+          const uint32_t objectID = table.objectIDs[instID];
+          scene->instances[instID]
+            = std::make_shared<Instance>(objectID == InstanceTable::NO_OBJECT
+                                         ? Object::SP() : objects[objectID],
+                                         table.transforms[instID]);
+        }
+      });
+  }
+  
+  /*! returns the bounds the given TOC stores for given mesh, or
+      null if it does not store any (TOC version 1) */
+  inline const box3f *storedBounds(const TOC &toc, size_t meshID)
+  {
+    return toc.meshInfos.size() == toc.meshes.size()
+      ? &toc.meshInfos[meshID].bounds
+      : nullptr;
+  }
+  
+  /*! parses a file with a TOC, by going through that TOC. Textures
+      and meshes get read and constructed in parallel (each task with
+      its own reader), the (small) rest of the scene is read serially
+      once those are done. With an arena, all nodes get created in
+      that, and the scene keeps it alive. See io::readMeshArrays() for
+      'compactIndices' */
+  template<typename Readers>
+  Scene::SP loadWithTOC(const Readers &readers, const TOC &toc,
+                        Arena::SP arena = {}, bool compactIndices = false)
+  {
+    typedef typename Readers::In In;
+    Scene::SP scene = std::make_shared<Scene>();
+    scene->arena = arena;
+
+    std::vector<Material::SP> materials = loadMaterials(readers,toc,arena.get());
+
+    std::vector<Mesh::SP> meshes(toc.meshes.size());
+    parallel_for_blocked(0,meshes.size(),meshesPerTask,
+                         [&](size_t begin, size_t end){
+        readers.withReader([&](In &in){
+            for (size_t meshID=begin;meshID<end;meshID++) {
+              io::seek(in,toc.meshes[meshID].offset);
+              meshes[meshID] = io::readMesh(in,materials,storedBounds(toc,meshID),
+                                            arena.get(),compactIndices);
+            }
+          });
+      });
+
+    loadSceneGraph(readers,toc,meshes,scene.get(),arena.get());
+    return scene;
+  }
+
+  /*! returns the size of the file that given stream is reading */
+  size_t getFileSize(std::istream &in)
+  {
+    size_t pos = in.tellg();
+    in.seekg(0,std::ios::end);
+    size_t size = in.tellg();
+    in.seekg(pos);
+    return size;
+  }
+  
+  /*! opens the given file the way 'options' say, and calls
+      job(in,fileSize,readers), with 'in' reading that file from its
+      start, and 'readers' handing out readers for the same file to
+      multiple threads. 'job' has to work with all kinds of readers */
+  template<typename Job>
+  void withFile(const std::string &fileName, const LoadOptions &options, Job &job)
+  {
+    if (options.mapped) {
+      io::MappedReader in(MappedFile::open(fileName));
+      job(in,in.file->size,MappedReaders(in.file));
+    } else if (options.readMethod != LoadOptions::READ_STREAM) {
+      BulkReaders readers(fileName,options.readMethod);
+      readers.withReader([&](std::istream &in){
+          job(in,readers.file->size,readers);
+        });
+    } else {
+      std::ifstream in(fileName,std::ios::binary);
+      if (!in.good())
+        throw std::runtime_error("could not open Scene{"+fileName+"}");
+      job(in,getFileSize(in),StreamReaders(fileName));
+    }
+  }
+
+  /*! checks the file magic, and reads the file's TOC; returns false
+      (without reading anything else) for version 11 files, which
+      don't have a TOC */
+  template<typename In>
+  bool readTOCIfAny(In &in, size_t fileSize, TOC &toc)
+  {
+    int version = versionFromMagic(io::readElement<size_t>(in));
+    if (version < 0)
+      throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic) - cannot load");
+    if (version == 11)
+      return false;
+    io::readTOC(in,fileSize,toc);
+    return true;
+  }
+
+  /*! number of records each parallel verification task checks */
+  const size_t recordsPerTask = 16;
+  
+  /*! checks the checksums of the TOC block and of all records it
+      lists, in parallel; the TOC must have checksums */
+  template<typename Readers>
+  void verifyRecords(const Readers &readers, const TOC &toc, VerifyResult &result)
+  {
+    typedef typename Readers::In In;
+    struct Record {
+      std::string name;
+      TOC::Chunk  chunk;
+    };
+    std::vector<Record> records;
+    toc.forEachRecord([&](const char *kind, int index, const TOC::Chunk &chunk){
+        records.push_back({index < 0 ? kind : kind+(" #"+std::to_string(index)),chunk});
+      });
+    records.push_back({"TOC",toc.block});
+
+    std::vector<uint8_t> intact(records.size(),false);
+    parallel_for_blocked(0,records.size(),recordsPerTask,
+                         [&](size_t begin, size_t end){
+        size_t next = begin;
+        while (next < end)
+          readers.withReader([&](In &in){
+              /* a record that (according to a corrupt TOC) extends
+                 past the end of the file leaves the reader unusable,
+                 so the rest get checked with a new one */
+              try {
+                for (;next<end;next++)
+                  intact[next] = io::checksumRange(in,records[next].chunk)
+                    == records[next].chunk.checksum;
+              } catch (const std::runtime_error &) {
+                next++;
+              }
+            });
+      });
+
+    result.hasChecksums = true;
+    for (size_t i=0;i<records.size();i++) {
+      result.numRecords++;
+      result.numBytes += records[i].chunk.size;
+      if (!intact[i])
+        result.corruptRecords.push_back(records[i].name);
+    }
+  }
+
+  /*! if requested (and the file has checksums), checks all of the
+      file's checksums, and throws if any doesn't match */
+  template<typename Readers>
+  void verifyIfRequested(const Readers &readers, const TOC &toc,
+                         const LoadOptions &options)
+  {
+    if (!options.verifyChecksums || !toc.hasChecksums)
+      return;
+    VerifyResult result;
+    verifyRecords(readers,toc,result);
+    if (!result.corruptRecords.empty())
+      throw std::runtime_error("corrupt 'mini' file: checksum mismatch in "
+                               +result.corruptRecords.front()
+                               +(result.corruptRecords.size() > 1
+                                 ? " (and "+std::to_string(result.corruptRecords.size()-1)+" more records)"
+                                 : std::string("")));
+  }
+  
+  /*! what Scene::load() does with an opened file (see withFile()) */
+  struct LoadJob {
+    template<typename In, typename Readers>
+    void operator()(In &in, size_t fileSize, const Readers &readers)
+    {
+      TOC toc;
+      if (!readTOCIfAny(in,fileSize,toc)) {
+        scene = loadV11(in);
+        return;
+      }
+      verifyIfRequested(readers,toc,options);
+      scene = loadWithTOC(readers,toc,
+                          options.useArena ? Arena::create() : Arena::SP(),
+                          options.compactIndices);
+    }
+    LoadOptions options;
+    Scene::SP   scene;
+  };
+  
+  Scene::SP Scene::load(const std::string &baseName, const LoadOptions &options)
+  {
+    LoadJob job;
+    job.options = options;
+    withFile(baseName,options,job);
+    return job.scene;
+  }
+
+  Scene::SP Scene::loadMapped(const std::string &baseName)
+  {
+    LoadOptions options;
+    options.mapped = true;
+    return load(baseName,options);
+  }
+
+  /*! what Scene::verify() does with an opened file */
+  struct VerifyJob {
+    template<typename In, typename Readers>
+    void operator()(In &in, size_t fileSize, const Readers &readers)
+    {
+      TOC toc;
+      if (readTOCIfAny(in,fileSize,toc) && toc.hasChecksums)
+        verifyRecords(readers,toc,result);
+    }
+    VerifyResult result;
+  };
+  
+  VerifyResult Scene::verify(const std::string &fileName, const LoadOptions &options)
+  {
+    VerifyJob job;
+    withFile(fileName,options,job);
+    return job.result;
+  }
+
+  Object::SP Scene::loadObject(const std::string &fileName, int objectID)
+  {
+    TOC toc = TOC::read(fileName);
+    if (objectID < 0 || objectID >= (int)toc.objects.size())
+      throw std::runtime_error("invalid object ID "+std::to_string(objectID));
+
+    StreamReaders readers(fileName);
+    std::vector<Material::SP> materials = loadMaterials(readers,toc);
+
+    Object::SP object;
+    readers.withReader([&](std::ifstream &in){
+        io::seek(in,toc.objects[objectID].offset);
+        std::vector<int> meshIDs;
+        io::readVector(in,meshIDs);
+
+        /* only read the meshes this object refers to */
+        std::vector<Mesh::SP> meshes(toc.meshes.size());
+        for (auto meshID : meshIDs) {
+          if (meshID < 0 || meshID >= (int)meshes.size() || meshes[meshID]) continue;
+          io::seek(in,toc.meshes[meshID].offset);
+          meshes[meshID] = io::readMesh(in,materials,storedBounds(toc,meshID));
+        }
+        io::seek(in,toc.objects[objectID].offset);
+        object = io::readObject(in,meshes);
+      });
+    return object;
+  }
+
+  Scene::SP Scene::loadPaged(const std::string &fileName, size_t memoryBudget)
+  {
+    {
+      std::ifstream in(fileName,std::ios::binary);
+      if (!in.good())
+        throw std::runtime_error("could not open Scene{"+fileName+"}");
+      if (versionFromMagic(io::readElement<size_t>(in)) < 12)
+        /* no TOC, so no way of paging anything */
+        return load(fileName);
+    }
+    TOC toc = TOC::read(fileName);
+    if (toc.meshInfos.size() != toc.meshes.size())
+      /* no mesh infos, we'd have to read the meshes anyway */
+      return load(fileName);
+
+    StreamReaders readers(fileName);
+    std::vector<Material::SP> materials = loadMaterials(readers,toc);
+
+    MeshPager::SP pager
+      = std::make_shared<MeshPager>(fileName,toc.meshes,memoryBudget);
+    std::vector<Mesh::SP> meshes;
+    for (size_t meshID=0;meshID<toc.meshes.size();meshID++) {
+      const TOC::MeshInfo &info = toc.meshInfos[meshID];
+      if (info.materialID < 0 || info.materialID >= (int)materials.size())
+        throw std::runtime_error("invalid material ID in 'mini' file");
+      Mesh::SP mesh = std::make_shared<Mesh>(materials[info.materialID]);
+      mesh->paging.pager       = pager;
+      mesh->paging.meshID      = (int)meshID;
+      mesh->paging.numPrims    = info.numPrims;
+      mesh->paging.numVertices = info.numVertices;
+      mesh->paging.bounds      = info.bounds;
+      meshes.push_back(mesh);
+    }
+
+    Scene::SP scene = std::make_shared<Scene>();
+    loadSceneGraph(readers,toc,meshes,scene.get());
+    return scene;
+  }
+  
+  /*! the loading thread's work for Scene::loadAsync() on a file with
+      a TOC: everything but the texels first, with the materials
+      referring to (so far empty) textures, and then the texels,
+      which get read directly into those textures */
+  template<typename Readers>
+  void loadAsyncWithTOC(const Readers &readers, const TOC &toc, AsyncLoad *load)
+  {
+    typedef typename Readers::In In;
+    load->numMeshes   = toc.meshes.size();
+    load->numTextures = toc.textures.size();
+
+    /* whether a texture is a null one is the first field of its
+       record, so that's all we need to read for now */
+    std::vector<Texture::SP> textures(toc.textures.size());
+    readers.withReader([&](In &in){
+        for (size_t texID=0;texID<textures.size();texID++) {
+          io::seek(in,toc.textures[texID].offset);
+          if (io::readElement<int>(in))
+            textures[texID] = Texture::create();
+        }
+      });
+    std::vector<Material::SP> materials = loadMaterials(readers,toc,textures);
+    load->bytesRead += toc.materials.size;
+
+    std::vector<Mesh::SP> meshes(toc.meshes.size());
+    parallel_for_blocked(0,meshes.size(),meshesPerTask,
+                         [&](size_t begin, size_t end){
+        readers.withReader([&](In &in){
+            for (size_t meshID=begin;meshID<end;meshID++) {
+              load->checkCancelled();
+              io::seek(in,toc.meshes[meshID].offset);
+              meshes[meshID] = io::readMesh(in,materials,storedBounds(toc,meshID));
+              load->bytesRead += toc.meshes[meshID].size;
+              load->meshesLoaded++;
+            }
+          });
+      });
+
+    load->checkCancelled();
+    Scene::SP scene = std::make_shared<Scene>();
+    loadSceneGraph(readers,toc,meshes,scene.get());
+    load->bytesRead += toc.lights.size + toc.instances.size;
+    for (auto &chunk : toc.objects)
+      load->bytesRead += chunk.size;
+    load->geometryLoaded(scene);
+
+    parallel_for(textures.size(),[&](size_t texID){
+        load->checkCancelled();
+        if (textures[texID])
+          readers.withReader([&](In &in){
+              io::seek(in,toc.textures[texID].offset);
+              io::readElement<int>(in);
+              io::readTextureData(in,textures[texID]);
+            });
+        load->bytesRead += toc.textures[texID].size;
+        load->texturesLoaded++;
+      });
+  }
+
+  /*! what the loading thread of Scene::loadAsync() does with the
+      opened file (see withFile()) */
+  struct AsyncLoadJob {
+    template<typename In, typename Readers>
+    void operator()(In &in, size_t fileSize, const Readers &readers)
+    {
+      load->totalBytes = fileSize;
+      TOC toc;
+      if (!readTOCIfAny(in,fileSize,toc)) {
+        /* no TOC, so the file can only be read front to back, with
+           the textures coming first */
+        load->geometryLoaded(loadV11(in));
+        return;
+      }
+      verifyIfRequested(readers,toc,options);
+      loadAsyncWithTOC(readers,toc,load);
+    }
+    LoadOptions options;
+    AsyncLoad  *load;
+  };
+  
+  AsyncLoad::SP Scene::loadAsync(const std::string &fileName,
+                                 const LoadOptions &options)
+  {
+    AsyncLoad::SP handle = std::make_shared<AsyncLoad>();
+    /* the handle joins the thread when it dies, so the thread must
+       not keep it alive */
+    AsyncLoad *load = handle.get();
+    load->thread = std::thread([load,fileName,options](){
+        AsyncLoadJob job;
+        job.options = options;
+        job.load    = load;
+        try {
+          withFile(fileName,options,job);
+          load->bytesRead = load->totalBytes.load();
+          load->finished(AsyncLoad::DONE);
+        } catch (const AsyncLoad::Cancelled &) {
+          load->finished(AsyncLoad::CANCELLED);
+        } catch (...) {
+          load->finished(AsyncLoad::FAILED,std::current_exception());
+        }
+      });
+    return handle;
+  }
+  
+  TOC TOC::read(const std::string &fileName)
+  {
+    std::ifstream in(fileName,std::ios::binary);
+    if (!in.good())
+      throw std::runtime_error("could not open file '"+fileName+"'");
+    TOC toc;
+    io::readTOC(in,getFileSize(in),toc);
+    return toc;
+  }
+
+  SceneInfo Scene::peekInfo(const std::string &fileName)
+  {
+    {
+      std::ifstream in(fileName,std::ios::binary);
+      if (!in.good())
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      SceneInfo info;
+      if (io::readSummary(in,getFileSize(in),info))
+        return info;
+    }
+    
+    if (!SceneReader::canRead(fileName))
+      return loadMapped(fileName)->getInfo();
+
+    /* file has a TOC but no summary yet - gather the summary from its
+       records; that doesn't need any mesh data unless the TOC
+       doesn't have mesh infos, either */
+    struct Visitor : public SceneVisitor {
+      void onTexture(int, const Texture &texture) override
+      { builder.addTexture(texture); }
+      void onLights(const std::vector<QuadLight> &quadLights,
+                    const std::vector<DirLight>  &dirLights,
+                    EnvMapLight::SP envMapLight) override
+      { builder.setLights(quadLights,dirLights,envMapLight); }
+      void onObject(int, const std::vector<int> &meshIDs) override
+      { builder.addObject(meshIDs); }
+      void onMesh(int, int meshID, const Mesh &mesh, int) override
+      {
+        meshInfos[meshID].numPrims    = mesh.getNumPrims();
+        meshInfos[meshID].numVertices = mesh.getNumVertices();
+        meshInfos[meshID].bounds      = mesh.getBounds();
+      }
+      void onInstance(int, const affine3f &xfm, int objectID) override
+      { builder.addInstance(xfm,objectID); }
+      
+      SceneInfoBuilder           builder;
+      std::vector<TOC::MeshInfo> meshInfos;
+    };
+    
+    SceneReader reader(fileName);
+    Visitor visitor;
+    reader.visitTextures(visitor);
+    reader.visitLights(visitor);
+    reader.visitObjects(visitor,/*withMeshes:*/false);
+    reader.visitInstances(visitor);
+    visitor.meshInfos = reader.toc.meshInfos;
+    if (visitor.meshInfos.size() != reader.numMeshes()) {
+      visitor.meshInfos.resize(reader.numMeshes());
+      for (int meshID=0;meshID<(int)reader.numMeshes();meshID++)
+        reader.visitMesh(meshID,visitor);
+    }
+    SceneInfo info = visitor.builder.finish(visitor.meshInfos,reader.numMaterials());
+    /* null instances don't get visited, but do get counted */
+    info.numInstances = reader.numInstances();
+    return info;
+  }
+  
 } // ::brix
 
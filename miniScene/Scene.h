@@ -17,6 +17,9 @@
 #pragma once
 
 #include "miniScene/common.h"
+#include "miniScene/Array.h"
+// std
+#include <atomic>
 
 namespace mini {
     
@@ -39,7 +42,7 @@ namespace mini {
        number of pixels in x and y */
     vec2i  size    { 0, 0 };
     Format format  { UNDEFINED };
-    std::vector<uint8_t> data;
+    Array<uint8_t> data;
   };
 
   /* a Disney-style material that can represent both metallic,
@@ -95,34 +98,188 @@ namespace mini {
     std::shared_ptr<Texture> alphaTexture;
   };
 
+  struct MeshPager;
+
+  /*! a bounding box that gets computed when first asked for, and
+      then cached until it gets invalidated. The cache is valid for
+      a given 'version' only; asking for any other version
+      re-computes it. Can be queried by several threads at the same
+      time, but not while anybody invalidates it. Copies of a cache
+      start out invalid */
+  struct BoundsCache {
+    BoundsCache() = default;
+    BoundsCache(const BoundsCache &) {}
+    BoundsCache &operator=(const BoundsCache &) { invalidate(); return *this; }
+
+    /*! returns the cached bounds if they are valid for given
+        version, else computes (and caches) them with compute().
+        compute() runs without any lock held - it may run parallel
+        loops whose worker threads come back to this same cache (or
+        to others) - so threads asking at the same time may all
+        compute the bounds, and the first one to finish caches them */
+    template<typename Compute>
+    box3f get(uint64_t version, const Compute &compute) const
+    {
+      if (validFor.load(std::memory_order_acquire) == version+1)
+        return bounds;
+      const uint64_t generation = this->generation.load(std::memory_order_acquire);
+      const box3f computed = compute();
+      std::lock_guard<std::mutex> lock(mutex);
+      /* don't cache anything computed from data that got changed
+         (and invalidated) in the meantime */
+      if (validFor.load(std::memory_order_relaxed) != version+1 &&
+          this->generation.load(std::memory_order_relaxed) == generation) {
+        bounds = computed;
+        validFor.store(version+1,std::memory_order_release);
+      }
+      return computed;
+    }
+
+    /*! sets the cached bounds for given version, without computing
+        anything (eg, with bounds stored in a file) */
+    void set(const box3f &b, uint64_t version = 0)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      bounds = b;
+      validFor.store(version+1,std::memory_order_release);
+    }
+    
+    void invalidate()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      generation.fetch_add(1,std::memory_order_release);
+      validFor.store(0,std::memory_order_release);
+    }
+    
+  private:
+    mutable std::mutex            mutex;
+    mutable box3f                 bounds;
+    /*! version the cached bounds are valid for, plus one; 0 if
+        invalid */
+    mutable std::atomic<uint64_t> validFor   { 0 };
+    /*! number of times this cache got invalidated */
+    std::atomic<uint64_t>         generation { 0 };
+  };
+  
   /*! a typical triangle mesh that mesh embree and optix mesh requirements */
   struct Mesh {
     typedef std::shared_ptr<Mesh> SP;
     
     Mesh(Material::SP material = {}) : material(material) {}
+    ~Mesh();
 
     inline static SP create(Material::SP material = {}) { return std::make_shared<Mesh>(material); }
     
     bool   isEmissive() const { return material->isEmissive(); }
-    size_t getNumPrims() const { return indices.size(); }
-
-    /*! computes a bounding box over all the triangles in this mesh */
+    /*! number of triangles; for paged meshes this works even when
+        the mesh is not resident */
+    size_t getNumPrims() const;
+    /*! number of vertices; for paged meshes this works even when
+        the mesh is not resident */
+    size_t getNumVertices() const;
+
+    /*! number of bytes per vertex index: 2 if the triangles are
+        stored in indices16, else 4 */
+    int getIndexWidth() const
+    { return indices16.empty() ? sizeof(int32_t) : sizeof(uint16_t); }
+
+    /*! calls op(triangles,numTriangles) once, with 'triangles'
+        being either a 'const vec3i *' or a 'const vec3us *',
+        depending on which width this mesh's indices are stored
+        with. 'op' is meant to be a functor with a templated
+        operator(), so code reading the triangles gets written once,
+        and compiled for both widths - rather than checking the
+        width for every triangle */
+    template<typename Op>
+    void withIndices(Op &&op) const
+    {
+      if (indices16.empty())
+        op(indices.data(),indices.size());
+      else
+        op(indices16.data(),indices16.size());
+    }
+
+    /*! whether all of this mesh's vertex indices fit into 16 bits */
+    bool canCompactIndices() const;
+    
+    /*! if all vertex indices fit into 16 bits, moves the triangles
+        from 'indices' to 'indices16'; returns whether the triangles
+        are (now) stored with 16-bit indices */
+    bool compactIndices();
+
+    /*! moves the triangles back from 'indices16' to 'indices' (if
+        they're stored in the former) */
+    void expandIndices();
+
+    /*! returns the bounding box over all the triangles in this
+        mesh. This gets computed once and then cached, so after
+        changing the mesh's vertices call markDirty(). For paged
+        meshes and meshes loaded from files with a TOC these are the
+        bounds stored in the file, which cost nothing to compute */
     box3f getBounds() const;
 
+    /*! to be called after changing this mesh's vertices: invalidates
+        the cached bounds of this mesh, and of all objects (which
+        then re-compute theirs from their meshes' cached bounds) */
+    void markDirty();
+
+    /*! whether this is a 'paged' mesh (see Scene::loadPaged()), whose
+        arrays only get read from file when needed */
+    bool isPaged() const { return (bool)paging.pager; }
+
+    /*! for paged meshes: reads this mesh's arrays if they're not
+        already in memory, and 'pins' them there until the matching
+        release(). Resident meshes that are no longer pinned stay in
+        memory until their pager exceeds its memory budget. Does
+        nothing for regular meshes */
+    void makeResident();
+
+    /*! for paged meshes: releases a pin acquired by makeResident(),
+        allowing this mesh's arrays to be evicted again. Note that
+        evicting drops any changes made to those arrays */
+    void release();
+    
+    /*! what a paged mesh knows about itself without having its
+        arrays in memory */
+    struct Paging {
+      std::shared_ptr<MeshPager> pager;
+      /*! ID of this mesh in the file the pager reads from */
+      int    meshID      { -1 };
+      size_t numPrims    { 0 };
+      size_t numVertices { 0 };
+      box3f  bounds;
+    } paging;
+
+    /*! keeps a (paged) mesh resident for as long as it lives */
+    struct Pin {
+      Pin(Mesh *mesh) : mesh(mesh) { mesh->makeResident(); }
+      ~Pin() { mesh->release(); }
+      Mesh *const mesh;
+    };
+
     /*! array of vertices */
-    std::vector<vec3f> vertices;
+    Array<vec3f> vertices;
 
     /*! one vertex normal per vertex; or empty */
-    std::vector<vec3f> normals;
+    Array<vec3f> normals;
     
     /*! one texture coordinate per vertex; or empty */
-    std::vector<vec2f> texcoords;
+    Array<vec2f> texcoords;
     
     /*! the vector containing the triangles' vertex indices */
-    std::vector<vec3i> indices;
+    Array<vec3i> indices;
+
+    /*! the triangles' vertex indices with 16 bits each, for meshes
+        whose indices all fit in that (see compactIndices()). If this
+        is non-empty it's these that describe the triangles, and
+        'indices' is empty */
+    Array<vec3us> indices16;
 
     /*! the material to be applied to this mesh */
     Material::SP       material;
+
+    /*! see getBounds() */
+    BoundsCache        cachedBounds;
   };
 
   /*! an object is a collection of one or more meshes. note it is
@@ -151,8 +308,15 @@ namespace mini {
     
     /*! computes and returns the bounding box of this object, which is
         the bounding box over all the mshes that this object
-        contains */
+        contains. Gets cached (see markDirty()), and computed from the
+        meshes' own cached bounds, so this does not look at any
+        vertices unless some mesh's bounds are not known yet */
     box3f getBounds() const;
+
+    /*! to be called after changing this object's list of meshes
+        (changes to the meshes themselves are taken care of by
+        Mesh::markDirty()) */
+    void markDirty() { cachedBounds.invalidate(); }
     
     /*! list of all geometries in this object. if this object is in
       a partial scene / extracted sub-scene this array will
@@ -160,6 +324,10 @@ namespace mini {
       was extracted from, just some of its elements might be
       empty */
     std::vector<Mesh::SP> meshes;
+
+    /*! see getBounds(); valid for a given value of the counter
+        Mesh::markDirty() increments */
+    BoundsCache           cachedBounds;
   };
 
   /*! represents instances of objects, with an affine transformation matrix */
@@ -173,13 +341,51 @@ namespace mini {
     inline static SP create(Object::SP object = 0, const affine3f &xfm = affine3f())
     { return std::make_shared<Instance>(object,xfm); }
 
-    /*! computes and returns the world-space bounding box of this instance */
+    /*! computes and returns the world-space bounding box of this
+        instance (from its object's cached bounds); empty for
+        instances of null objects */
     box3f getBounds() const;
     
     affine3f   xfm;
     Object::SP object;
   };
 
+  /*! a scene's instances in 'structure of arrays' form: instance i
+      is an instance of object objectIDs[i] (an index into 'objects',
+      or NO_OBJECT for instances of null objects) with transform
+      transforms[i]; unless bit i of 'valid' is cleared, in which
+      case it's a null instance. This is how instances are stored in
+      files, so it can be read in one go (and, from a memory-mapped
+      file, without copying), and 'transforms' can be handed straight
+      to a renderer's top-level acceleration structure build */
+  struct InstanceTable {
+    typedef std::shared_ptr<InstanceTable> SP;
+
+    enum : uint32_t { NO_OBJECT = 0xffffffffu };
+
+    inline size_t size() const { return transforms.size(); }
+
+    inline bool isValid(size_t instID) const
+    { return (valid[instID/64] >> (instID%64)) & 1; }
+
+    /*! whether all instances are valid, and refer to an object - ie,
+        whether 'transforms' and 'objectIDs' can be used as they are,
+        without skipping any instances */
+    bool isDense() const;
+    
+    /*! appends an instance */
+    void push_back(const affine3f &xfm, uint32_t objectID, bool isValid = true);
+    
+    Array<affine3f> transforms;
+    Array<uint32_t> objectIDs;
+    /*! one bit per instance */
+    Array<uint64_t> valid;
+    /*! the objects that 'objectIDs' refer to; may be empty if the
+        table came straight from a file (see SceneReader), in which
+        case object IDs are the file's */
+    std::vector<Object::SP> objects;
+  };
+
   /*! a quadrilateral area light that emits light into the direction
       pointed to by the normal. The light shape is given by an
       "anchor" point describing one of the corners of the light
@@ -234,6 +440,141 @@ namespace mini {
     affine3f    transform;
   };
 
+  /*! summary statistics of a scene. .mini files store these, so
+      they can be queried without loading the scene (see
+      Scene::peekInfo()) */
+  struct SceneInfo {
+    /*! number of instances, including null ones */
+    size_t numInstances       { 0 };
+    size_t numObjects         { 0 };
+    /*! counts over all meshes in the scene, counting each mesh once */
+    size_t numUniqueMeshes    { 0 };
+    size_t numUniqueTriangles { 0 };
+    size_t numUniqueVertices  { 0 };
+    /*! counts over all instances, ie, counting each mesh as often
+        as it gets instantiated */
+    size_t numActualMeshes    { 0 };
+    size_t numActualTriangles { 0 };
+    size_t numActualVertices  { 0 };
+    /*! number of (non-null) textures, and how many of those are ptex */
+    size_t numTextures        { 0 };
+    size_t numPtexTextures    { 0 };
+    size_t numPtexBytes       { 0 };
+    size_t numTexelBytes      { 0 };
+    size_t numMaterials       { 0 };
+    size_t numQuadLights      { 0 };
+    size_t numDirLights       { 0 };
+    /*! resolution of the env-map light's texture; (0,0) if there is
+        no env-map light */
+    vec2i  envMapSize         { 0,0 };
+    box3f  worldBounds;
+  };
+  
+  /*! options for how a scene gets written to a file */
+  struct SaveOptions {
+    /*! pad the file such that every array's payload starts at a
+        multiple of 64 bytes (of the page size, for large arrays), so
+        memory-mapped arrays are aligned for SIMD loads, and arrays
+        can be read with O_DIRECT. Costs up to 63 bytes per array
+        (4095 for large ones) */
+    bool alignArrays { false };
+    /*! if non-zero, store vertex positions quantized to this many
+        bits (at most 21) per coordinate, relative to each mesh's
+        bounding box (see QuantizedPositions) */
+    int quantizePositionBits { 0 };
+    /*! if non-zero, meshes whose quantization error (in any
+        coordinate) would exceed this keep their original positions */
+    float maxQuantizationError { 0.f };
+    /*! store triangle indices compressed (see CompressedIndices),
+        for all meshes where that actually saves space */
+    bool compressIndices { false };
+    /*! store large arrays (mesh arrays, texels, ...) block-wise
+        compressed (see CompressedBlocks) */
+    bool compressArrays { false };
+    /*! store meshes that are byte-for-byte identical (including their
+        material) only once; all objects using any of them will then
+        share that one mesh */
+    bool dedupMeshes { false };
+    /*! store materials that have the same value (ie, the same
+        fields, and the same textures) only once; see
+        Scene::dedupMaterials() */
+    bool dedupMaterials { false };
+  };
+
+  /*! what saving a scene did beyond just writing it out */
+  struct SaveStats {
+    /*! number of meshes that were folded into identical ones (see
+        SaveOptions::dedupMeshes), and bytes of mesh arrays saved by
+        doing so */
+    size_t numDedupedMeshes       { 0 };
+    size_t numDedupedMeshBytes    { 0 };
+    /*! number of textures whose contents are identical to those of
+        another texture (these always get stored only once), and
+        bytes of texture data saved by that */
+    size_t numDedupedTextures     { 0 };
+    size_t numDedupedTextureBytes { 0 };
+    /*! number of materials folded into ones with the same value (see
+        SaveOptions::dedupMaterials) */
+    size_t numDedupedMaterials    { 0 };
+  };
+
+  /*! options for Scene::load() and Scene::loadAsync() */
+  struct LoadOptions {
+    /*! how a file that doesn't get memory-mapped gets read */
+    typedef enum {
+      /*! one blocking std::istream::read at a time */
+      READ_STREAM=0,
+      /*! large arrays get read as many chunks that are all in flight
+          at the same time - through io_uring where available, and a
+          pool of threads doing positional reads otherwise (see
+          io::ReadQueue) */
+      READ_BULK,
+      /*! as READ_BULK, but always using the pool of threads */
+      READ_BULK_THREADS
+    } ReadMethod;
+    
+    /*! memory-map the file (see Scene::loadMapped()) rather than
+        reading it into owned arrays */
+    bool mapped { false };
+    ReadMethod readMethod { READ_STREAM };
+    /*! check every record's checksum before loading anything, and
+        throw if any of them doesn't match. Files written before
+        checksums were added (TOC version 4) load as if this was off */
+    bool verifyChecksums { false };
+    /*! create all instances, objects, meshes and materials - and the
+        meshes' arrays, unless those are views into a mapping or
+        stored quantized/compressed - in one Arena (see Scene::arena),
+        rather than allocating each of them on its own. Makes loading
+        and destroying scenes with many nodes faster. Only applies to
+        Scene::load() of files with a TOC */
+    bool useArena { false };
+    /*! keep the triangles of meshes whose vertex indices all fit
+        into 16 bits in Mesh::indices16 (as files store them), rather
+        than widening them into Mesh::indices. Halves the memory
+        for indices of such meshes, but code reading them has
+        to go through Mesh::withIndices(). Only applies to
+        Scene::load() of files with a TOC */
+    bool compactIndices { false };
+  };
+
+  /*! what Scene::verify() found out about a file */
+  struct VerifyResult {
+    /*! whether the file has checksums at all */
+    bool   hasChecksums { false };
+    /*! number of records (including header and TOC) checked, and
+        their total size in bytes */
+    size_t numRecords   { 0 };
+    size_t numBytes     { 0 };
+    /*! names (like "mesh #12") of all records whose checksums do
+        not match */
+    std::vector<std::string> corruptRecords;
+
+    bool isIntact() const { return hasChecksums && corruptRecords.empty(); }
+  };
+
+  struct AsyncLoad;
+  struct Arena;
+  
   /*! a complete scene, consisting of a list of instances (may be a
       single one if the scene doesn't use instantiation), and some
       light sources */
@@ -252,40 +593,143 @@ namespace mini {
     { return std::make_shared<Scene>(instances); }
   
     /*! computes and returns the world space bounding box of this
-        scene. Note that for scene with many instances that can take a
-        while */
+        scene, from its objects' cached bounds (see
+        Object::getBounds()); this costs one box transform per
+        instance, no matter how many vertices the scene has */
     box3f getBounds() const;
 
+    /*! computes the summary statistics of this scene */
+    SceneInfo getInfo() const;
+
+    /*! returns this scene's instances as an InstanceTable. For a
+        scene loaded from a file that's the table read from that
+        file (see 'instanceTable'), which costs nothing; otherwise it
+        gets built from 'instances', with the objects listed in order
+        of their first use (which is the order they get saved in).
+        The returned table may be shared, so must not be modified */
+    InstanceTable::SP getInstanceTable() const;
+
+    /*! to be called after changing this scene's instances (or their
+        transforms, or objects): drops the instance table kept from
+        loading the scene, which no longer matches them */
+    void markInstancesDirty() { instanceTable = nullptr; }
+
+    /*! makes all meshes whose materials have the same value (the
+        same fields, and textures of the same contents) use the same
+        material; returns the number of materials that are no longer
+        used by any mesh after that */
+    size_t dedupMaterials();
+
+    /*! returns the summary statistics of the scene in given ".mini"
+        file. For files written by this version of the library this
+        reads only a small, fixed-size block near the end of the
+        file; older files get scanned (or, if too old to have a TOC,
+        loaded) to compute these */
+    static SceneInfo peekInfo(const std::string &fileName);
+
     /*! loads a ".mini" file from the given file */
-    static Scene::SP load(const std::string &fileName);
+    static Scene::SP load(const std::string &fileName,
+                          const LoadOptions &options = LoadOptions());
+
+    /*! loads a ".mini" file by memory-mapping it, with all mesh
+        arrays and texture data being views into that mapping rather
+        than copies (see Array<T>). Loading this way is much faster
+        and uses far less memory for consumers that mostly read the
+        scene; the mapping stays alive for as long as any of the
+        scene's arrays refers to it */
+    static Scene::SP loadMapped(const std::string &fileName);
+
+    /*! loads only the given object (and the meshes, materials and
+        textures it uses) from a ".mini" file, using that file's table
+        of contents to read only what is required. Requires a file
+        of format version 12 or newer */
+    static Object::SP loadObject(const std::string &fileName, int objectID);
+
+    /*! loads a ".mini" file in 'paged' mode, in which all meshes are
+        only lightweight handles that know their counts, bounds, and
+        where in the file they are; their arrays only get read when
+        someone calls Mesh::makeResident() on them (see Mesh::Pin),
+        and get evicted again (least recently used first) when the
+        arrays of all resident meshes exceed the given memory budget
+        (in bytes). This allows for working on scenes much larger
+        than memory, in particular for tools that mostly operate on
+        the scene graph. Files that are too old to contain the
+        required mesh infos get loaded as with load() */
+    static Scene::SP loadPaged(const std::string &fileName,
+                               size_t memoryBudget = size_t(8)<<30);
+
+    /*! checks the checksums of all records of the given ".mini"
+        file, without loading any of them; throws if the file is not
+        even structurally valid (ie, if its TOC cannot be read). Reads
+        the file the way 'options' says, checking records in
+        parallel */
+    static VerifyResult verify(const std::string &fileName,
+                               const LoadOptions &options = LoadOptions());
+
+    /*! starts loading a ".mini" file on a background thread, and
+        returns a handle through which to monitor the load's
+        progress, cancel it, and obtain the scene. Geometry gets
+        loaded first, and is available (through
+        AsyncLoad::waitForGeometry()) while texture data is still
+        being read; see AsyncLoad for what consumers may and may not
+        do with the scene in that phase */
+    static std::shared_ptr<AsyncLoad> loadAsync(const std::string &fileName,
+                                                const LoadOptions &options
+                                                = LoadOptions());
 
     /*! saves the model in file with given name, using a binary file
         format that can be loaded with Scene::load() */
-    void save(const std::string &fileName);
+    SaveStats save(const std::string &fileName,
+                   const SaveOptions &options = SaveOptions());
+
+    /*! saves the model exactly as save() would (the resulting file is
+        byte-for-byte identical), but first computes where in the
+        file each texture, mesh, etc goes, and then writes all of
+        those concurrently, with positional writes. Falls back to
+        save() on platforms without positional writes, and for scenes
+        that have paged meshes (see loadPaged()) - the records of
+        those meshes can only be sized by reading them */
+    SaveStats saveParallel(const std::string &fileName,
+                           const SaveOptions &options = SaveOptions());
       
     std::vector<QuadLight>  quadLights;
     std::vector<DirLight>   dirLights;
     EnvMapLight::SP         envMapLight;
     
     std::vector<Instance::SP> instances;
+    /*! for scenes loaded from a file: the instance table read from
+        that file (referring to all of the file's objects, in the
+        file's order), which getInstanceTable() hands out for as long
+        as it still matches 'instances' - ie, until instances get
+        added or removed, or markInstancesDirty() gets called. Its
+        arrays are views into the file for memory-mapped scenes */
+    InstanceTable::SP         instanceTable;
+
+    /*! for scenes loaded with LoadOptions::useArena: the arena its
+        instances, objects, meshes and materials live in. Each of
+        those nodes keeps the arena alive as well, so they can be
+        used after the scene is gone just like any other nodes */
+    std::shared_ptr<Arena>    arena;
   };
 
   /*! helper function for computing the bounding box of an affinely
       transformed box3f; usually used to compute the world-space
       bounding box of an instance (given that instance's affine
       transform matrix and the object-space bounding box of the object
-      being instantiated) */
+      being instantiated). Rather than transforming all eight corners,
+      this adds up, per dimension, the smaller and larger of what the
+      box's lower and upper coordinates contribute (the same math as
+      the SSE kernel in Bounds.cpp, so results match that exactly) */
   inline box3f xfmBox(const affine3f &xfm, const box3f &box)
   {
-    box3f result;
-    for (int iz=0;iz<2;iz++)
-      for (int iy=0;iy<2;iy++)
-        for (int ix=0;ix<2;ix++) {
-          vec3f v(ix ? box.upper.x : box.lower.x,
-                  iy ? box.upper.y : box.lower.y,
-                  iz ? box.upper.z : box.lower.z);
-          result.extend(xfmPoint(xfm,v));
-        }
+    box3f result(xfm.p,xfm.p);
+    const vec3f *column = &xfm.l.vx;
+    for (int d=0;d<3;d++) {
+      const vec3f a = column[d] * box.lower[d];
+      const vec3f b = column[d] * box.upper[d];
+      result.lower = result.lower + min(a,b);
+      result.upper = result.upper + max(a,b);
+    }
     return result;
   }
   
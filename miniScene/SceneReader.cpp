@@ -0,0 +1,165 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/SceneReader.h"
+
+namespace mini {
+
+  SceneReader::SceneReader(const std::string &fileName)
+    : file(MappedFile::open(fileName))
+  {
+    io::MappedReader in(file);
+    if (versionFromMagic(io::readElement<size_t>(in)) < 0)
+      throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic)");
+    io::readTOC(in,file->size,toc);
+  }
+
+  bool SceneReader::canRead(const std::string &fileName)
+  {
+    std::ifstream in(fileName,std::ios::binary);
+    size_t magic = 0;
+    in.read((char*)&magic,sizeof(magic));
+    return in.good() && versionFromMagic(magic) >= 12;
+  }
+  
+  size_t SceneReader::numMaterials() const
+  {
+    io::MappedReader in(file);
+    io::seek(in,toc.materials.offset);
+    return io::readElement<size_t>(in);
+  }
+  
+  size_t SceneReader::numInstances() const
+  {
+    io::MappedReader in(file);
+    io::seek(in,toc.instances.offset);
+    return io::readElement<size_t>(in);
+  }
+  
+  void SceneReader::visit(SceneVisitor &visitor)
+  {
+    visitTextures(visitor);
+    visitLights(visitor);
+    visitMaterials(visitor);
+    visitObjects(visitor);
+    visitInstances(visitor);
+  }
+    
+  void SceneReader::visitTextures(SceneVisitor &visitor)
+  {
+    io::MappedReader in(file);
+    for (int texID=1;texID<(int)toc.textures.size();texID++) {
+      const TOC::Chunk &chunk = toc.textures[texID];
+      io::seek(in,chunk.offset);
+      if (!io::readElement<int>(in))
+        continue;
+      Texture::SP texture = std::make_shared<Texture>();
+      io::readTextureData(in,texture);
+      visitor.onTexture(texID,*texture);
+      texture = nullptr;
+      file->release(chunk.offset,chunk.size);
+    }
+  }
+  
+  void SceneReader::visitLights(SceneVisitor &visitor)
+  {
+    io::MappedReader in(file);
+    io::seek(in,toc.lights.offset);
+    Scene lights;
+    io::readLights(in,&lights);
+    visitor.onLights(lights.quadLights,lights.dirLights,lights.envMapLight);
+  }
+  
+  void SceneReader::visitMaterials(SceneVisitor &visitor)
+  {
+    io::MappedReader in(file);
+    io::seek(in,toc.materials.offset);
+    size_t numMaterials = io::readElement<size_t>(in);
+    for (int matID=0;matID<(int)numMaterials;matID++) {
+      int colorTextureID, alphaTextureID;
+      Material::SP material = io::readMaterial(in,colorTextureID,alphaTextureID);
+      if (colorTextureID < 0 || colorTextureID >= (int)toc.textures.size() ||
+          alphaTextureID < 0 || alphaTextureID >= (int)toc.textures.size())
+        throw std::runtime_error("invalid texture ID in 'mini' file");
+      visitor.onMaterial(matID,*material,colorTextureID,alphaTextureID);
+    }
+  }
+
+  void SceneReader::visitObjects(SceneVisitor &visitor, bool withMeshes)
+  {
+    for (int objID=0;objID<(int)toc.objects.size();objID++)
+      visitObject(objID,visitor,withMeshes);
+  }
+  
+  void SceneReader::visitObject(int objectID, SceneVisitor &visitor, bool withMeshes)
+  {
+    if (objectID < 0 || objectID >= (int)toc.objects.size())
+      throw std::runtime_error("SceneReader: invalid object ID");
+    io::MappedReader in(file);
+    io::seek(in,toc.objects[objectID].offset);
+    std::vector<int> meshIDs;
+    io::readVector(in,meshIDs);
+    for (auto meshID : meshIDs)
+      if (meshID >= (int)toc.meshes.size())
+        throw std::runtime_error("invalid mesh ID in 'mini' file");
+    visitor.onObject(objectID,meshIDs);
+    if (withMeshes)
+      for (auto meshID : meshIDs)
+        if (meshID >= 0)
+          visitMesh(meshID,visitor,objectID);
+  }
+  
+  void SceneReader::visitMesh(int meshID, SceneVisitor &visitor, int objectID)
+  {
+    if (meshID < 0 || meshID >= (int)toc.meshes.size())
+      throw std::runtime_error("SceneReader: invalid mesh ID");
+    const TOC::Chunk &chunk = toc.meshes[meshID];
+    io::MappedReader in(file);
+    io::seek(in,chunk.offset);
+    int flags = io::readElement<int>(in);
+    if (!(flags & MESH_FLAG_VALID))
+      return;
+    {
+      Mesh mesh;
+      io::readMeshArrays(in,&mesh,flags);
+      int materialID = io::readElement<int>(in);
+      visitor.onMesh(objectID,meshID,mesh,materialID);
+    }
+    file->release(chunk.offset,chunk.size);
+  }
+  
+  void SceneReader::visitInstances(SceneVisitor &visitor)
+  {
+    InstanceTable::SP table = readInstanceTable();
+    for (size_t instID=0;instID<table->size();instID++) {
+      if (!table->isValid(instID))
+        continue;
+      const uint32_t objectID = table->objectIDs[instID];
+      visitor.onInstance((int)instID,table->transforms[instID],
+                         objectID == InstanceTable::NO_OBJECT ? -1 : (int)objectID);
+    }
+  }
+
+  InstanceTable::SP SceneReader::readInstanceTable()
+  {
+    io::MappedReader in(file);
+    io::seek(in,toc.instances.offset);
+    InstanceTable::SP table = std::make_shared<InstanceTable>();
+    io::readInstanceTable(in,toc.formatVersion,toc.objects.size(),*table);
+    return table;
+  }
+  
+} // ::mini
@@ -0,0 +1,111 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/FileFormat.h"
+
+namespace mini {
+
+  /*! receives the content of a .mini file from a SceneReader, one
+      item at a time. Everything passed to a callback is only valid
+      for the duration of that callback - it's typically a view right
+      into the (memory-mapped) file - so visitors that need to keep
+      anything have to copy it. Items refer to each other by the IDs
+      they have in the file. */
+  struct SceneVisitor {
+    virtual ~SceneVisitor() = default;
+
+    /*! a (non-null) texture; the null texture always has ID 0 and
+        does not get visited */
+    virtual void onTexture(int textureID, const Texture &texture) {}
+
+    virtual void onLights(const std::vector<QuadLight> &quadLights,
+                          const std::vector<DirLight>  &dirLights,
+                          EnvMapLight::SP envMapLight) {}
+
+    /*! a material; its own texture pointers are null, the textures it
+        uses are given by ID (0 for 'none') */
+    virtual void onMaterial(int materialID, const Material &material,
+                            int colorTextureID, int alphaTextureID) {}
+
+    /*! an object, and the IDs of the meshes it's made of */
+    virtual void onObject(int objectID, const std::vector<int> &meshIDs) {}
+
+    /*! a mesh, as used by the given object (-1 if the mesh was
+        visited on its own); the mesh's material pointer is null, the
+        material it uses is given by ID */
+    virtual void onMesh(int objectID, int meshID, const Mesh &mesh, int materialID) {}
+
+    /*! a (non-null) instance; objectID is -1 for instances of a null
+        object */
+    virtual void onInstance(int instanceID, const affine3f &xfm, int objectID) {}
+  };
+  
+  /*! walks a .mini file and hands its content to a SceneVisitor,
+      without ever materializing the scene: every mesh and texture is
+      a view into the memory-mapped file that's only valid during its
+      callback, and whose pages get released right after. This lets
+      statistics, validation, or conversion passes process files of
+      any size in (almost) constant memory.
+
+      Requires a file with a TOC (see FileFormat.h); use canRead() to
+      check, and Scene::load() for older files. */
+  struct SceneReader {
+    SceneReader(const std::string &fileName);
+
+    /*! whether the given file can be read by a SceneReader */
+    static bool canRead(const std::string &fileName);
+
+    /*! visits everything in the file: textures, lights, materials,
+        then all objects (each followed by its meshes), then the
+        instances. Meshes used by multiple objects get visited once
+        per object */
+    void visit(SceneVisitor &visitor);
+    
+    void visitTextures(SceneVisitor &visitor);
+    void visitLights(SceneVisitor &visitor);
+    void visitMaterials(SceneVisitor &visitor);
+    /*! visits all objects; only fires onMesh for their meshes if
+        'withMeshes' is set */
+    void visitObjects(SceneVisitor &visitor, bool withMeshes = true);
+    /*! visits given object; only fires onMesh for its meshes if
+        'withMeshes' is set */
+    void visitObject(int objectID, SceneVisitor &visitor, bool withMeshes = true);
+    /*! visits a single mesh, on behalf of given object */
+    void visitMesh(int meshID, SceneVisitor &visitor, int objectID = -1);
+    void visitInstances(SceneVisitor &visitor);
+
+    /*! reads the instance table; its arrays are views into the
+        memory-mapped file (where alignment permits), and its object
+        IDs are the file's (ie, its 'objects' is empty) */
+    InstanceTable::SP readInstanceTable();
+
+    size_t numTextures()  const { return toc.textures.size(); }
+    size_t numMaterials() const;
+    size_t numMeshes()    const { return toc.meshes.size(); }
+    size_t numObjects()   const { return toc.objects.size(); }
+    size_t numInstances() const;
+
+    /*! the file's table of contents; also has each mesh's
+        size and bounds (if the file is recent enough) */
+    TOC toc;
+    
+  private:
+    MappedFile::SP file;
+  };
+  
+} // ::mini
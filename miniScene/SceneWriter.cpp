@@ -0,0 +1,233 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/SceneWriter.h"
+
+namespace mini {
+
+  SceneWriter::SceneWriter(const std::string &fileName,
+                           const SaveOptions &options)
+    : out(fileName,std::ios::binary),
+      fileName(fileName),
+      options(options)
+  {
+    if (!out.good())
+      throw std::runtime_error("could not open file '"+fileName+"'");
+    if (options.alignArrays) {
+      toc.formatFlags |= FORMAT_FLAG_ALIGNED_ARRAYS;
+      io::alignArrays(out) = true;
+    }
+    if (options.compressArrays) {
+      toc.formatFlags |= FORMAT_FLAG_COMPRESSED_ARRAYS;
+      io::compressArrays(out) = true;
+    }
+    io::writeRecord(out,toc.header,[&](std::ostream &out){
+        io::writeElement(out,magicForVersion(FORMAT_VERSION));
+        io::writeElement(out,toc.formatFlags);
+      });
+
+    // texture ID 0 is always the null texture
+    TOC::Chunk chunk;
+    io::writeRecord(out,chunk,[&](std::ostream &out){
+        io::writeTexture(out,{});
+      });
+    toc.textures.push_back(chunk);
+  }
+
+  int SceneWriter::add(Texture::SP texture)
+  {
+    if (!texture) return 0;
+    int ID = textures.find(texture);
+    if (ID >= 0) return ID;
+
+    /* we don't keep textures around, so to check whether one with
+       the same hash really is the same, read that one back */
+    std::vector<int> &sameHash = textureHashes[contentHash(*texture)];
+    for (int candidateID : sameHash) {
+      out.flush();
+      std::ifstream in(fileName,std::ios::binary);
+      in.seekg(toc.textures[candidateID].offset);
+      Texture::SP candidate = io::readTexture(in);
+      if (candidate && sameContents(*candidate,*texture)) {
+        textures.add(texture,candidateID);
+        return candidateID;
+      }
+    }
+    
+    ID = (int)toc.textures.size();
+    sameHash.push_back(ID);
+    TOC::Chunk chunk;
+    io::writeRecord(out,chunk,[&](std::ostream &out){
+        io::writeTexture(out,texture);
+      });
+    toc.textures.push_back(chunk);
+    textures.add(texture,ID);
+    summary.addTexture(*texture);
+    return ID;
+  }
+  
+  int SceneWriter::add(Material::SP material)
+  {
+    assert(material);
+    int ID = materials.find(material);
+    if (ID >= 0) return ID;
+
+    MaterialRecord record;
+    record.material = material->clone();
+    record.material->colorTexture = {};
+    record.material->alphaTexture = {};
+    record.colorTextureID = add(material->colorTexture);
+    record.alphaTextureID = add(material->alphaTexture);
+
+    if (options.dedupMaterials) {
+      const MaterialValue value(*material,record.colorTextureID,record.alphaTextureID);
+      auto it = materialValues.find(value);
+      if (it != materialValues.end()) {
+        materials.add(material,it->second);
+        return it->second;
+      }
+      materialValues[value] = (int)materialRecords.size();
+    }
+    
+    ID = (int)materialRecords.size();
+    materialRecords.push_back(record);
+    materials.add(material,ID);
+    return ID;
+  }
+  
+  int SceneWriter::add(Mesh::SP mesh)
+  {
+    if (!mesh) return -1;
+    int ID = meshes.find(mesh);
+    if (ID >= 0) return ID;
+
+    TOC::MeshInfo info;
+    info.materialID  = add(mesh->material);
+    info.numPrims    = mesh->getNumPrims();
+    info.numVertices = mesh->getNumVertices();
+    info.bounds      = mesh->getBounds();
+    
+    TOC::Chunk chunk;
+    {
+      Mesh::Pin pin(mesh.get());
+      io::writeRecord(out,chunk,[&](std::ostream &out){
+          io::writeMesh(out,mesh,info.materialID,encodeForSave(*mesh,options));
+        });
+    }
+    
+    ID = (int)toc.meshes.size();
+    toc.meshes.push_back(chunk);
+    toc.meshInfos.push_back(info);
+    meshes.add(mesh,ID);
+    return ID;
+  }
+  
+  int SceneWriter::add(Object::SP object)
+  {
+    assert(object);
+    int ID = objects.find(object);
+    if (ID >= 0) return ID;
+
+    std::vector<int> meshIDs;
+    for (auto mesh : object->meshes)
+      meshIDs.push_back(add(mesh));
+    ID = addObject(meshIDs);
+    objects.add(object,ID);
+    return ID;
+  }
+
+  int SceneWriter::addObject(const std::vector<int> &meshIDs)
+  {
+    for (auto meshID : meshIDs)
+      if (meshID >= (int)toc.meshes.size())
+        throw std::runtime_error("SceneWriter: object refers to mesh that wasn't added");
+    
+    TOC::Chunk chunk;
+    io::writeRecord(out,chunk,[&](std::ostream &out){
+        io::writeObject(out,meshIDs);
+      });
+
+    int ID = (int)toc.objects.size();
+    toc.objects.push_back(chunk);
+    summary.addObject(meshIDs);
+    return ID;
+  }
+
+  void SceneWriter::add(Instance::SP instance)
+  {
+    if (!instance) {
+      instances.push_back(affine3f(),InstanceTable::NO_OBJECT,false);
+      summary.addInstance(affine3f(),-1);
+      return;
+    }
+    addInstance(instance->object ? add(instance->object) : -1,
+                instance->xfm);
+  }
+
+  void SceneWriter::addInstance(int objectID, const affine3f &xfm)
+  {
+    if (objectID >= (int)toc.objects.size())
+      throw std::runtime_error("SceneWriter: instance refers to object that wasn't added");
+    instances.push_back(xfm,objectID < 0 ? (uint32_t)InstanceTable::NO_OBJECT : (uint32_t)objectID);
+    summary.addInstance(xfm,objectID);
+  }
+  
+  void SceneWriter::finish()
+  {
+    if (finished)
+      throw std::runtime_error("SceneWriter::finish() called twice");
+    finished = true;
+
+    // ------------------------------------------------------------------
+    // lights
+    // ------------------------------------------------------------------
+    {
+      Scene lights;
+      lights.quadLights  = quadLights;
+      lights.dirLights   = dirLights;
+      lights.envMapLight = envMapLight;
+      io::writeRecord(out,toc.lights,[&](std::ostream &out){
+          io::writeLights(out,&lights);
+        });
+      summary.setLights(quadLights,dirLights,envMapLight);
+    }
+    
+    // ------------------------------------------------------------------
+    // materials
+    // ------------------------------------------------------------------
+    io::writeRecord(out,toc.materials,[&](std::ostream &out){
+        io::writeElement(out,materialRecords.size());
+        for (auto &record : materialRecords)
+          io::writeMaterial(out,record.material,
+                            record.colorTextureID,record.alphaTextureID);
+      });
+
+    // ------------------------------------------------------------------
+    // instances
+    // ------------------------------------------------------------------
+    io::writeRecord(out,toc.instances,[&](std::ostream &out){
+        io::writeInstanceTable(out,instances);
+      });
+
+    toc.summary = summary.finish(toc.meshInfos,materialRecords.size());
+
+    io::writeTOC(out,toc);
+    out.close();
+    if (!out.good())
+      throw std::runtime_error("some error happened while writing '"+fileName+"'");
+  }
+  
+} // ::mini
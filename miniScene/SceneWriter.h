@@ -0,0 +1,135 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/FileFormat.h"
+#include "miniScene/Serialized.h"
+
+namespace mini {
+
+  /*! writes a .mini file incrementally, while the scene is still being
+      produced (typically, by an importer): textures, meshes, and
+      objects get written to disk as soon as they're added, so the
+      importer can drop them right after. Only the (small) material
+      table, lights, and instance table are kept in memory until
+      finish() writes them, together with the file's TOC.
+
+      The writer does not hold on to anything that was added to it; it
+      only remembers (by weak reference) what it has already written,
+      so adding the same texture, material, mesh or object twice
+      returns the same ID. Textures with the same contents as one
+      that was already written also get that one's ID. Since every
+      record's location ends up in the TOC, the resulting file can
+      be read just like one written by Scene::save(). */
+  struct SceneWriter {
+    SceneWriter(const std::string &fileName,
+                const SaveOptions &options = SaveOptions());
+
+    /*! adds a texture (if not already added) and returns its ID; the
+        null texture always has ID 0 */
+    int add(Texture::SP texture);
+    
+    /*! adds a material (and its textures) if not already added, and
+        returns its ID */
+    int add(Material::SP material);
+    
+    /*! adds and writes a mesh (and its material) if not already
+        added, and returns its ID */
+    int add(Mesh::SP mesh);
+
+    /*! adds an object (and all its meshes) if not already added, and
+        returns its ID */
+    int add(Object::SP object);
+
+    /*! adds an object made up of already added meshes (-1 for null
+        meshes), and returns its ID */
+    int addObject(const std::vector<int> &meshIDs);
+
+    /*! adds an instance (and its object, if not already added); may
+        be null */
+    void add(Instance::SP instance);
+
+    /*! adds an instance of an already added object */
+    void addInstance(int objectID, const affine3f &xfm = affine3f());
+    
+    /*! writes everything that's still in memory, plus the TOC. The
+        file is not a valid .mini file before this got called */
+    void finish();
+
+    /*! lights, get written in finish() */
+    std::vector<QuadLight>  quadLights;
+    std::vector<DirLight>   dirLights;
+    EnvMapLight::SP         envMapLight;
+    
+  private:
+    /*! remembers which objects of type T were already assigned which
+        ID, without keeping these objects alive */
+    template<typename T>
+    struct Registry {
+      /*! returns the ID of the given object, or -1 if unknown */
+      int find(const std::shared_ptr<T> &t) const
+      {
+        auto it = known.find(t.get());
+        if (it == known.end() || it->second.first.expired())
+          /* if expired, this is a different object that just happens
+             to live at the same address */
+          return -1;
+        return it->second.second;
+      }
+      void add(const std::shared_ptr<T> &t, int ID)
+      { known[t.get()] = { t, ID }; }
+
+      std::map<const T *,std::pair<std::weak_ptr<T>,int>> known;
+    };
+
+    /*! materials get written in finish(), so we have to store them;
+        but without references to their textures, so we don't keep
+        those alive */
+    struct MaterialRecord {
+      Material::SP material;
+      int          colorTextureID;
+      int          alphaTextureID;
+    };
+    
+    std::ofstream  out;
+    const std::string fileName;
+    const SaveOptions options;
+    TOC            toc;
+    bool           finished { false };
+
+    Registry<Texture>  textures;
+    Registry<Material> materials;
+    Registry<Mesh>     meshes;
+    Registry<Object>   objects;
+
+    /*! for each texture content hash, the IDs of the textures with
+        that hash that were written so far */
+    std::map<uint64_t,std::vector<int>> textureHashes;
+
+    /*! with SaveOptions::dedupMaterials: the ID of the material
+        written for each material value */
+    std::map<MaterialValue,int> materialValues;
+    
+    std::vector<MaterialRecord> materialRecords;
+    /*! instances get written in finish(); stored by object ID, so
+        we don't keep their objects alive */
+    InstanceTable               instances;
+    /*! computes the file's summary as we go */
+    SceneInfoBuilder            summary;
+  };
+
+} // ::mini
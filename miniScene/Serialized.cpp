@@ -15,10 +15,101 @@
 // ======================================================================== //
 
 #include "miniScene/Serialized.h"
+#include "miniScene/Hash.h"
 
 namespace mini {
     
-    SerializedScene::SerializedScene(Scene *scene)
+    template<typename T>
+    inline uint64_t hashArray(const Array<T> &array, uint64_t seed)
+    { return hashBytes(array.data(),array.size()*sizeof(T),seed+array.size()); }
+
+    template<typename T>
+    inline bool sameArray(const Array<T> &a, const Array<T> &b)
+    {
+      return a.size() == b.size()
+        && (a.empty() || !memcmp(a.data(),b.data(),a.size()*sizeof(T)));
+    }
+
+    /*! folds every non-null entry of 'serialized' that is the same
+        (according to 'same') as an earlier one into that earlier
+        entry's ID. 'hash(t)' computes a hash of t's contents (in
+        parallel across entries); only entries with equal hashes get
+        compared. Calls 'folded(t)' for each entry that got folded,
+        and returns how many those were */
+    template<typename T, typename Hash, typename Same, typename Folded>
+    size_t foldDuplicates(Serialized<T> &serialized,
+                          const Hash &hash, const Same &same,
+                          const Folded &folded)
+    {
+      std::vector<uint64_t> hashes(serialized.size());
+      parallel_for(serialized.size(),[&](size_t ID){
+          if (serialized[ID]) hashes[ID] = hash(serialized[ID]);
+        });
+
+      /* for each hash, the (new) IDs of the unique entries with it */
+      std::map<uint64_t,std::vector<int>> candidates;
+      Serialized<T> unique;
+      size_t numFolded = 0;
+      for (size_t ID=0;ID<serialized.size();ID++) {
+        const T t = serialized[ID];
+        if (!t) {
+          unique.add(t);
+          continue;
+        }
+        std::vector<int> &sameHash = candidates[hashes[ID]];
+        int uniqueID = -1;
+        for (int candidateID : sameHash)
+          if (same(t,unique[candidateID])) {
+            uniqueID = candidateID;
+            break;
+          }
+        if (uniqueID < 0) {
+          sameHash.push_back((int)unique.size());
+          unique.add(t);
+        } else {
+          unique.alias(t,uniqueID);
+          folded(t);
+          numFolded++;
+        }
+      }
+      /* anything that already was an alias stays one */
+      for (auto &t : serialized.aliases)
+        unique.alias(t,unique.getID(serialized[serialized.getID(t)]));
+      serialized = unique;
+      return numFolded;
+    }
+    
+    uint64_t contentHash(const Texture &texture)
+    {
+      uint64_t hash = hashBytes(&texture.size,sizeof(texture.size),texture.format);
+      return hashArray(texture.data,hash);
+    }
+
+    bool sameContents(const Texture &a, const Texture &b)
+    {
+      return a.size == b.size && a.format == b.format
+        && sameArray(a.data,b.data);
+    }
+    
+    MaterialValue::MaterialValue(const Material &material,
+                                 int colorTextureID, int alphaTextureID)
+    {
+      /* no padding in here, but let's be sure comparing bytes works */
+      memset((void*)this,0,sizeof(*this));
+      this->emission       = material.emission;
+      this->baseColor      = material.baseColor;
+      this->metallic       = material.metallic;
+      this->roughness      = material.roughness;
+      this->transmission   = material.transmission;
+      this->ior            = material.ior;
+      this->colorTextureID = colorTextureID;
+      this->alphaTextureID = alphaTextureID;
+    }
+
+    uint64_t MaterialValue::hash() const
+    { return hashBytes(this,sizeof(*this)); }
+    
+    SerializedScene::SerializedScene(const Scene *scene)
     {
       textures.add(nullptr);
 
@@ -40,6 +131,72 @@ namespace mini {
           textures.add(material->alphaTexture);
         }
       }
+
+      dedupTextures();
+    }
+
+    void SerializedScene::dedupTextures()
+    {
+      numDedupedTextures = foldDuplicates
+        (textures,
+         [](const Texture::SP &tex) { return contentHash(*tex); },
+         [](const Texture::SP &a, const Texture::SP &b) {
+           return sameContents(*a,*b);
+         },
+         [&](const Texture::SP &tex) {
+           numDedupedTextureBytes += tex->data.size();
+         });
+    }
+    
+    size_t SerializedScene::dedupMaterials()
+    {
+      auto valueOf = [&](const Material::SP &mat) {
+        return MaterialValue(*mat,getID(mat->colorTexture),getID(mat->alphaTexture));
+      };
+      return foldDuplicates
+        (materials,
+         [&](const Material::SP &mat) { return valueOf(mat).hash(); },
+         [&](const Material::SP &a, const Material::SP &b) {
+           return valueOf(a) == valueOf(b);
+         },
+         [](const Material::SP &) {});
+    }
+    
+    size_t SerializedScene::dedupMeshes()
+    {
+      size_t numBytesSaved = 0;
+      foldDuplicates
+        (meshes,
+         [&](const Mesh::SP &mesh) {
+           Mesh::Pin pin(mesh.get());
+           const int materialID = getID(mesh->material);
+           uint64_t hash = hashBytes(&materialID,sizeof(materialID));
+           hash = hashArray(mesh->vertices,hash);
+           hash = hashArray(mesh->normals,hash);
+           hash = hashArray(mesh->texcoords,hash);
+           hash = hashArray(mesh->indices,hash);
+           return hashArray(mesh->indices16,hash);
+         },
+         [&](const Mesh::SP &a, const Mesh::SP &b) {
+           Mesh::Pin pinA(a.get());
+           Mesh::Pin pinB(b.get());
+           return getID(a->material) == getID(b->material)
+             && sameArray(a->vertices,b->vertices)
+             && sameArray(a->normals,b->normals)
+             && sameArray(a->texcoords,b->texcoords)
+             && sameArray(a->indices,b->indices)
+             && sameArray(a->indices16,b->indices16);
+         },
+         [&](const Mesh::SP &mesh) {
+           Mesh::Pin pin(mesh.get());
+           numBytesSaved
+             += mesh->vertices.size()*sizeof(vec3f)
+             +  mesh->normals.size()*sizeof(vec3f)
+             +  mesh->texcoords.size()*sizeof(vec2f)
+             +  mesh->indices.size()*sizeof(vec3i)
+             +  mesh->indices16.size()*sizeof(vec3us);
+         });
+      return numBytesSaved;
     }
 
 } // ::mini
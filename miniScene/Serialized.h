@@ -21,54 +21,182 @@
 namespace mini {
   // namespace scene {
     
+    /*! maps pointers to (non-negative) IDs. An open-addressing hash
+        table with linear probing over a flat array of (pointer,ID)
+        slots, so a lookup typically touches a single cache line */
+    struct IDRegistry {
+      /*! returns the ID of given pointer, or -1 if unknown */
+      inline int find(const void *ptr) const
+      {
+        if (!ptr) return nullID;
+        if (slots.empty()) return -1;
+        for (size_t i=hash(ptr);;i=(i+1)&mask()) {
+          if (slots[i].ptr == ptr) return slots[i].ID;
+          if (!slots[i].ptr) return -1;
+        }
+      }
+
+      /*! assigns given ID to given pointer, unless that pointer
+          already has an ID; returns the ID the pointer had before
+          (or -1 if it didn't have one) */
+      inline int insert(const void *ptr, int ID)
+      {
+        if (!ptr) {
+          const int prevID = nullID;
+          if (prevID < 0) nullID = ID;
+          return prevID;
+        }
+        /* keep the table at most half full */
+        if (2*(numEntries+1) > slots.size())
+          rehash(std::max(size_t(64),2*slots.size()));
+        size_t i=hash(ptr);
+        for (;slots[i].ptr;i=(i+1)&mask())
+          if (slots[i].ptr == ptr) return slots[i].ID;
+        slots[i].ptr = ptr;
+        slots[i].ID  = ID;
+        numEntries++;
+        return -1;
+      }
+
+    private:
+      struct Slot {
+        const void *ptr { nullptr };
+        int         ID  { -1 };
+      };
+      
+      inline size_t mask() const { return slots.size()-1; }
+      
+      inline size_t hash(const void *ptr) const
+      {
+        /* fibonacci hashing; low bits of pointers are mostly zero */
+        return size_t((uint64_t(ptr) * 0x9E3779B97F4A7C15ull) >> 32) & mask();
+      }
+      
+      void rehash(size_t numSlots)
+      {
+        std::vector<Slot> old(numSlots);
+        old.swap(slots);
+        for (auto &slot : old)
+          if (slot.ptr) {
+            size_t i=hash(slot.ptr);
+            while (slots[i].ptr) i=(i+1)&mask();
+            slots[i] = slot;
+          }
+      }
+      
+      std::vector<Slot> slots;
+      size_t            numEntries { 0 };
+      int               nullID     { -1 };
+    };
+    
+    /*! a list of (shared pointers to) T's, plus a registry for
+        finding the ID - ie, the position in that list - of each */
     template<typename T>
     struct Serialized {
       inline size_t size() const { return list.size(); }
       inline const T &operator[](int ID) const
       { assert(ID>=0); assert(ID<list.size()); return list[ID]; }
       
-      int getID(T t)
-      {
-        if (registry.find(t) == registry.end())
-          return -1;
-
-        return registry[t];
-      }
+      inline int getID(const T &t) const
+      { return registry.find(t.get()); }
       
-      inline bool wasKnown(T t) const
-      {
-        return  (registry.find(t) != registry.end());
-      }
+      inline bool wasKnown(const T &t) const
+      { return getID(t) >= 0; }
 
-      bool addWasKnown(T t)
+      inline bool addWasKnown(const T &t)
       {
-        if (registry.find(t) != registry.end())
+        if (registry.insert(t.get(),(int)list.size()) >= 0)
           return true;
-
-        registry[t] = (int)list.size();
         list.push_back(t);
         return false;
       }
       
-      void add(T t) { addWasKnown(t); }
+      void add(const T &t) { addWasKnown(t); }
+
+      /*! makes 't' (which must not be known yet) another name for
+          the already known entry with given ID */
+      void alias(const T &t, int ID)
+      {
+        assert(!wasKnown(t));
+        assert(ID >= 0 && ID < (int)list.size());
+        registry.insert(t.get(),ID);
+        /* the registry only knows pointers, so keep 't' alive for as
+           long as its ID is */
+        aliases.push_back(t);
+      }
       
-      std::map<T,int> registry;
+      IDRegistry      registry;
       std::vector<T>  list;
+      std::vector<T>  aliases;
     };
 
+    /*! hash over a texture's contents, such that textures that
+        are the same (see sameContents()) have the same hash */
+    uint64_t contentHash(const Texture &texture);
+
+    /*! whether two textures have the exact same contents */
+    bool sameContents(const Texture &a, const Texture &b);
+    
+    /*! everything that gets stored about a material: its fields, and
+        the IDs of its textures. Materials with the same value are
+        interchangeable */
+    struct MaterialValue {
+      MaterialValue(const Material &material,
+                    int colorTextureID, int alphaTextureID);
+      
+      uint64_t hash() const;
+      bool operator==(const MaterialValue &other) const
+      { return memcmp(this,&other,sizeof(*this)) == 0; }
+      bool operator<(const MaterialValue &other) const
+      { return memcmp(this,&other,sizeof(*this)) < 0; }
+      
+      vec3f emission;
+      vec3f baseColor;
+      float metallic;
+      float roughness;
+      float transmission;
+      float ior;
+      int   colorTextureID;
+      int   alphaTextureID;
+    };
+    
     struct SerializedScene {
       SerializedScene() {}
-      SerializedScene(Scene *scene);
+      /*! serializes the given scene; textures with identical
+          contents get folded into one (see dedupTextures()) */
+      SerializedScene(const Scene *scene);
+
+      /*! folds meshes whose arrays and material are identical to
+          those of another mesh into that other mesh's ID (which is
+          what getID() then returns for them), so they get stored
+          only once. Returns the number of bytes of mesh arrays that
+          no longer need storing */
+      size_t dedupMeshes();
+
+      /*! same as dedupMeshes(), for textures: materials referring to
+          any of a set of identical textures will all refer to the
+          same texture ID */
+      void dedupTextures();
+
+      /*! same as dedupMeshes(), for materials: folds materials whose
+          value (see MaterialValue) is the same as that of another
+          material; returns the number of materials folded */
+      size_t dedupMaterials();
       
-      int getID(Texture::SP t)  { return textures.getID(t); }
-      int getID(Material::SP m) { return materials.getID(m); }
-      int getID(Mesh::SP t)     { return meshes.getID(t); }
-      int getID(Object::SP t)   { return objects.getID(t); }
+      int getID(const Texture::SP &t)  const { return textures.getID(t); }
+      int getID(const Material::SP &m) const { return materials.getID(m); }
+      int getID(const Mesh::SP &t)     const { return meshes.getID(t); }
+      int getID(const Object::SP &t)   const { return objects.getID(t); }
       
       Serialized<Texture::SP>  textures;
       Serialized<Material::SP> materials;
       Serialized<Object::SP>   objects;
       Serialized<Mesh::SP>     meshes;
+
+      /*! number of textures folded by dedupTextures(), and the
+          bytes of texture data saved by that */
+      size_t numDedupedTextures     { 0 };
+      size_t numDedupedTextureBytes { 0 };
     };
 
 } // ::mini
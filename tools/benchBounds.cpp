@@ -0,0 +1,156 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/*! micro-benchmark for the bounds kernels in Bounds.h: runs the
+    point kernel for every instruction set this CPU supports (and
+    the multi-threaded version) over an array of random vertices, and
+    the instance box kernel over random transforms; optionally also
+    times Scene::getBounds() for a given file, with and without the
+    meshes' cached bounds */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include "miniScene/Bounds.h"
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+namespace mini {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double secondsSince(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now()-t0).count();
+  }
+  
+  void usage(const std::string &msg)
+  {
+    if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchBounds [inFile.mini] [-n <numVertices>] [-r <repetitions>]" << std::endl;
+    std::cout << "Measures vertices/second of the SIMD bounds kernels" << std::endl;
+    exit(msg.empty() ? 0 : 1);
+  }
+
+  /*! runs 'lambda' numReps times, and returns the fastest time */
+  template<typename Lambda>
+  double bestOf(int numReps, const Lambda &lambda)
+  {
+    double best = 1e20;
+    for (int rep=0;rep<numReps;rep++) {
+      Clock::time_point t0 = Clock::now();
+      lambda();
+      best = std::min(best,secondsSince(t0));
+    }
+    return best;
+  }
+
+  void benchBounds(int ac, char **av)
+  {
+    std::string inFileName;
+    size_t numVertices = 16*1024*1024;
+    int numReps = 10;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-n")
+        numVertices = std::stoull(av[++i]);
+      else if (arg == "-r")
+        numReps = std::max(1,std::stoi(av[++i]));
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+
+    std::mt19937 rng(0x1234);
+    std::uniform_real_distribution<float> random(-1000.f,1000.f);
+    std::vector<vec3f> vertices(numVertices);
+    for (auto &v : vertices)
+      v = vec3f(random(rng),random(rng),random(rng));
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "#vertices : " << numVertices << std::endl;
+    const BoundsISA isas[]
+      = { BOUNDS_ISA_SCALAR, BOUNDS_ISA_SSE, BOUNDS_ISA_AVX2, BOUNDS_ISA_AVX512 };
+    for (auto isa : isas) {
+      if (!isSupported(isa)) continue;
+      box3f bounds;
+      double t = bestOf(numReps,[&](){
+          bounds = computeBounds(vertices.data(),vertices.size(),isa);
+        });
+      std::cout << std::setw(10) << std::left << toString(isa) << ": "
+                << (numVertices/t*1e-6) << " Mvertices/s" << std::endl;
+    }
+    double t = bestOf(numReps,[&](){
+        parallelComputeBounds(vertices.data(),vertices.size());
+      });
+    std::cout << std::setw(10) << std::left << "parallel" << ": "
+              << (numVertices/t*1e-6) << " Mvertices/s" << std::endl;
+
+    /* instance boxes: random (non-empty) boxes with random transforms */
+    const size_t numBoxes = std::max(size_t(1),numVertices/16);
+    std::vector<affine3f> xfms(numBoxes);
+    std::vector<box3f>    boxes(numBoxes);
+    for (size_t i=0;i<numBoxes;i++) {
+      const vec3f a(random(rng),random(rng),random(rng));
+      const vec3f b(random(rng),random(rng),random(rng));
+      boxes[i] = box3f(min(a,b),max(a,b));
+      xfms[i]  = affine3f(vec3f(random(rng),random(rng),random(rng)),
+                          vec3f(random(rng),random(rng),random(rng)),
+                          vec3f(random(rng),random(rng),random(rng)),
+                          vec3f(random(rng),random(rng),random(rng)));
+    }
+    std::cout << "#boxes    : " << numBoxes << std::endl;
+    for (auto isa : { BOUNDS_ISA_SCALAR, BOUNDS_ISA_SSE }) {
+      if (!isSupported(isa)) continue;
+      double t = bestOf(numReps,[&](){
+          computeBounds(xfms.data(),boxes.data(),numBoxes,isa);
+        });
+      std::cout << std::setw(10) << std::left << toString(isa) << ": "
+                << (numBoxes/t*1e-6) << " Mboxes/s" << std::endl;
+    }
+
+    if (inFileName.empty())
+      return;
+    
+    Scene::SP scene = Scene::load(inFileName);
+    SerializedScene serialized(scene.get());
+    size_t numSceneVertices = 0;
+    for (auto mesh : serialized.meshes.list)
+      if (mesh) numSceneVertices += mesh->getNumVertices();
+    std::cout << "scene     : " << serialized.meshes.size() << " meshes, "
+              << numSceneVertices << " vertices, "
+              << scene->instances.size() << " instances" << std::endl;
+    double uncached = bestOf(numReps,[&](){
+        for (auto mesh : serialized.meshes.list)
+          if (mesh) mesh->markDirty();
+        scene->getBounds();
+      });
+    double cached = bestOf(numReps,[&](){ scene->getBounds(); });
+    std::cout << std::setprecision(3)
+              << "getBounds : " << (uncached*1e3) << "ms uncached ("
+              << std::setprecision(1) << (numSceneVertices/uncached*1e-6)
+              << " Mvertices/s), " << std::setprecision(3)
+              << (cached*1e3) << "ms cached" << std::endl;
+  }
+  
+}
+
+int main(int ac, char **av)
+{ mini::benchBounds(ac,av); return 0; }
@@ -0,0 +1,129 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/*! micro-benchmark for CompressedIndices: for every unique mesh in
+    a scene, stores the mesh's indices both raw and compressed, and
+    compares bytes per triangle and read throughput of the two */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include "miniScene/FileFormat.h"
+#include <chrono>
+#include <iomanip>
+
+namespace mini {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double secondsSince(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now()-t0).count();
+  }
+  
+  void usage(const std::string &msg)
+  {
+    if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchIndices inFile.mini [-r <repetitions>]" << std::endl;
+    std::cout << "Compares size and decode speed of compressed vs raw triangle indices" << std::endl;
+    exit(msg.empty() ? 0 : 1);
+  }
+  
+  void benchIndices(int ac, char **av)
+  {
+    std::string inFileName;
+    int numReps = 10;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-r")
+        numReps = std::max(1,std::stoi(av[++i]));
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    Scene::SP scene = Scene::load(inFileName);
+    SerializedScene serialized(scene.get());
+
+    std::stringstream raw, compressed;
+    size_t numMeshes = 0, numTriangles = 0;
+    double encodeTime = 0.;
+    for (int meshID=0;meshID<(int)serialized.meshes.size();meshID++) {
+      Mesh::SP mesh = serialized.meshes[meshID];
+      if (!mesh) continue;
+      Mesh::Pin pin(mesh.get());
+      io::writeVector(raw,mesh->indices);
+      Clock::time_point t0 = Clock::now();
+      CompressedIndices::SP ci = CompressedIndices::encode(mesh->indices);
+      encodeTime += secondsSince(t0);
+      io::writeCompressedIndices(compressed,*ci);
+      numMeshes++;
+      numTriangles += mesh->indices.size();
+    }
+    if (numTriangles == 0)
+      throw std::runtime_error("scene does not contain any triangles");
+    const std::string rawBytes = raw.str();
+    const std::string compressedBytes = compressed.str();
+    const double decodedBytes = double(numTriangles*sizeof(vec3i));
+    
+    /* raw: just read the arrays back */
+    double rawTime = 1e20;
+    for (int rep=0;rep<numReps;rep++) {
+      std::istringstream in(rawBytes);
+      Array<vec3i> indices;
+      Clock::time_point t0 = Clock::now();
+      for (size_t i=0;i<numMeshes;i++)
+        io::readVector(in,indices);
+      rawTime = std::min(rawTime,secondsSince(t0));
+    }
+    
+    /* compressed: read the compressed arrays, and decode them */
+    double decodeTime = 1e20;
+    for (int rep=0;rep<numReps;rep++) {
+      std::istringstream in(compressedBytes);
+      Array<vec3i> indices;
+      Clock::time_point t0 = Clock::now();
+      for (size_t i=0;i<numMeshes;i++) {
+        CompressedIndices ci;
+        io::readCompressedIndices(in,ci);
+        ci.decode(indices);
+      }
+      decodeTime = std::min(decodeTime,secondsSince(t0));
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "#meshes    : " << numMeshes << std::endl;
+    std::cout << "#triangles : " << numTriangles << std::endl;
+    std::cout << "raw        : "
+              << (rawBytes.size()/double(numTriangles)) << " bytes/triangle, "
+              << (decodedBytes/rawTime*1e-9) << " GB/s read" << std::endl;
+    std::cout << "compressed : "
+              << (compressedBytes.size()/double(numTriangles)) << " bytes/triangle, "
+              << (decodedBytes/decodeTime*1e-9) << " GB/s read+decode, "
+              << (decodedBytes/encodeTime*1e-9) << " GB/s encode" << std::endl;
+    std::cout << "ratio      : "
+              << (rawBytes.size()/double(compressedBytes.size())) << "x" << std::endl;
+  }
+  
+}
+
+int main(int ac, char **av)
+{ mini::benchIndices(ac,av); return 0; }
@@ -0,0 +1,159 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/*! benchmark for the different ways Scene::load() can read a file:
+    one blocking std::istream::read at a time, or many chunks in
+    flight at once through an io::ReadQueue (io_uring, or a pool of
+    pread threads). Measures both plain file throughput and loading
+    the whole scene. For numbers that reflect the device rather than
+    the page cache, use '--cold' (which asks the kernel to drop the
+    file's cached pages before every run) */
+
+#include "miniScene/Scene.h"
+#include "miniScene/PositionalIO.h"
+#include <chrono>
+#include <iomanip>
+#ifdef __linux__
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace mini {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double secondsSince(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now()-t0).count();
+  }
+  
+  void usage(const std::string &msg)
+  {
+    if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchRead inFile.mini [-r <repetitions>] [--cold]" << std::endl;
+    std::cout << "Compares std::istream reads against io_uring/thread-pool bulk reads" << std::endl;
+    exit(msg.empty() ? 0 : 1);
+  }
+
+  /*! asks the kernel to evict the file's pages from the page cache
+      (which works for pages that aren't dirty, and doesn't need
+      special privileges) */
+  void dropCachedPages(const std::string &fileName)
+  {
+#ifdef __linux__
+    int fd = open(fileName.c_str(),O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+  }
+
+  /*! runs 'lambda' numReps times, and returns the fastest time */
+  template<typename Lambda>
+  double bestOf(int numReps, bool cold, const std::string &fileName,
+                const Lambda &lambda)
+  {
+    double best = 1e20;
+    for (int rep=0;rep<numReps;rep++) {
+      if (cold) dropCachedPages(fileName);
+      Clock::time_point t0 = Clock::now();
+      lambda();
+      best = std::min(best,secondsSince(t0));
+    }
+    return best;
+  }
+  
+  void benchRead(int ac, char **av)
+  {
+    std::string inFileName;
+    int numReps = 5;
+    bool cold = false;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-r")
+        numReps = std::max(1,std::stoi(av[++i]));
+      else if (arg == "--cold")
+        cold = true;
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    io::PositionalReadFile::SP file
+      = std::make_shared<io::PositionalReadFile>(inFileName);
+    const double fileGB = file->size*1e-9;
+    /* read the file in pieces about as large as big mesh arrays */
+    const size_t pieceSize = size_t(64)<<20;
+    std::vector<char> dest(std::min(file->size,pieceSize));
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "file       : " << inFileName << " (" << fileGB << " GB"
+              << (cold ? ", cold" : ", warm") << ")" << std::endl;
+    
+    double streamTime = bestOf(numReps,cold,inFileName,[&](){
+        std::ifstream in(inFileName,std::ios::binary);
+        for (size_t begin=0;begin<file->size;begin+=pieceSize)
+          in.read(dest.data(),std::min(pieceSize,file->size-begin));
+        if (!in.good())
+          throw std::runtime_error("error reading '"+inFileName+"'");
+      });
+    std::cout << "istream    : " << (fileGB/streamTime) << " GB/s read" << std::endl;
+
+    for (auto backend : { io::ReadQueue::THREAD_POOL, io::ReadQueue::IO_URING }) {
+      io::ReadQueue queue(file,backend);
+      if (queue.backend != backend) {
+        std::cout << std::left << std::setw(11) << io::ReadQueue::toString(backend)
+                  << ": not available" << std::endl;
+        continue;
+      }
+      double queueTime = bestOf(numReps,cold,inFileName,[&](){
+          for (size_t begin=0;begin<file->size;begin+=pieceSize)
+            queue.read(begin,dest.data(),std::min(pieceSize,file->size-begin));
+        });
+      std::cout << std::left << std::setw(11) << io::ReadQueue::toString(backend)
+                << ": " << (fileGB/queueTime) << " GB/s read" << std::endl;
+    }
+
+    struct {
+      const char             *name;
+      LoadOptions::ReadMethod method;
+    } methods[] = {
+      { "READ_STREAM",       LoadOptions::READ_STREAM },
+      { "READ_BULK_THREADS", LoadOptions::READ_BULK_THREADS },
+      { "READ_BULK",         LoadOptions::READ_BULK },
+    };
+    for (auto &method : methods) {
+      LoadOptions options;
+      options.readMethod = method.method;
+      double loadTime = bestOf(numReps,cold,inFileName,[&](){
+          Scene::load(inFileName,options);
+        });
+      std::cout << "load " << std::left << std::setw(17) << method.name << ": "
+                << loadTime << "s, " << (fileGB/loadTime) << " GB/s" << std::endl;
+    }
+  }
+  
+}
+
+int main(int ac, char **av)
+{ mini::benchRead(ac,av); return 0; }
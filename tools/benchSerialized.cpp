@@ -0,0 +1,160 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/*! micro-benchmark for the ID registry in Serialized<T>: builds the
+    SerializedScene of a scene, and looks up the IDs of all
+    instances' objects and meshes, both with Serialized<T> and with
+    a std::map<shared_ptr<T>,int> (which is what Serialized<T> used
+    before) */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include <chrono>
+#include <iomanip>
+
+namespace mini {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double secondsSince(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now()-t0).count();
+  }
+  
+  void usage(const std::string &msg)
+  {
+    if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchSerialized [inFile.mini] [-n <numInstances>] [-o <numObjects>]" << std::endl;
+    std::cout << "Without an input file, uses a synthetic scene with the given number" << std::endl;
+    std::cout << "of instances (default 1M) of the given number of objects (default 100K)" << std::endl;
+    exit(msg.empty() ? 0 : 1);
+  }
+
+  /*! the registry Serialized<T> used to have */
+  template<typename T>
+  struct MapRegistry {
+    int getID(const T &t)
+    {
+      if (registry.find(t) == registry.end())
+        return -1;
+      return registry[t];
+    }
+    void add(const T &t)
+    {
+      if (registry.find(t) != registry.end()) return;
+      registry[t] = (int)registry.size();
+    }
+    std::map<T,int> registry;
+  };
+  
+  Scene::SP makeSyntheticScene(size_t numInstances, size_t numObjects)
+  {
+    Material::SP material = Material::create();
+    std::vector<Object::SP> objects;
+    for (size_t i=0;i<numObjects;i++) {
+      Object::SP object = Object::create();
+      for (int j=0;j<1+int(i%3);j++)
+        object->meshes.push_back(Mesh::create(material));
+      objects.push_back(object);
+    }
+    Scene::SP scene = Scene::create();
+    /* spread out instances of the same object, as real scenes do */
+    for (size_t i=0;i<numInstances;i++)
+      scene->instances.push_back
+        (Instance::create(objects[(i*7919) % numObjects]));
+    return scene;
+  }
+  
+  void benchSerialized(int ac, char **av)
+  {
+    std::string inFileName;
+    size_t numInstances = 1000000;
+    size_t numObjects   = 100000;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-n")
+        numInstances = std::stoull(av[++i]);
+      else if (arg == "-o")
+        numObjects = std::max(size_t(1),(size_t)std::stoull(av[++i]));
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    
+    Scene::SP scene
+      = inFileName.empty()
+      ? makeSyntheticScene(numInstances,numObjects)
+      : Scene::loadPaged(inFileName);
+    std::cout << "#instances : " << scene->instances.size() << std::endl;
+
+    /* registering: what constructing the SerializedScene does */
+    Clock::time_point t0 = Clock::now();
+    SerializedScene serialized(scene.get());
+    const double flatBuild = secondsSince(t0);
+
+    t0 = Clock::now();
+    MapRegistry<Object::SP> mapObjects;
+    MapRegistry<Mesh::SP>   mapMeshes;
+    for (auto inst : scene->instances) {
+      if (!inst || !inst->object) continue;
+      if (mapObjects.getID(inst->object) >= 0) continue;
+      mapObjects.add(inst->object);
+      for (auto mesh : inst->object->meshes)
+        mapMeshes.add(mesh);
+    }
+    const double mapBuild = secondsSince(t0);
+    
+    /* looking up: what writing the objects and instances does */
+    size_t checksum = 0;
+    t0 = Clock::now();
+    for (auto inst : scene->instances) {
+      if (!inst || !inst->object) continue;
+      checksum += serialized.getID(inst->object);
+      for (auto &mesh : inst->object->meshes)
+        checksum += serialized.getID(mesh);
+    }
+    const double flatLookup = secondsSince(t0);
+
+    size_t mapChecksum = 0;
+    t0 = Clock::now();
+    for (auto inst : scene->instances) {
+      if (!inst || !inst->object) continue;
+      mapChecksum += mapObjects.getID(inst->object);
+      for (auto &mesh : inst->object->meshes)
+        mapChecksum += mapMeshes.getID(mesh);
+    }
+    const double mapLookup = secondsSince(t0);
+    if (checksum != mapChecksum)
+      throw std::runtime_error("registries disagree on IDs");
+    
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "#objects   : " << serialized.objects.size()
+              << ", #meshes : " << serialized.meshes.size() << std::endl;
+    std::cout << "build  : hash registry " << flatBuild*1e3 << "ms"
+              << " (whole SerializedScene), std::map " << mapBuild*1e3 << "ms" << std::endl;
+    std::cout << "lookup : hash registry " << flatLookup*1e3 << "ms"
+              << ", std::map " << mapLookup*1e3 << "ms"
+              << " (" << (mapLookup/flatLookup) << "x)" << std::endl;
+  }
+  
+}
+
+int main(int ac, char **av)
+{ mini::benchSerialized(ac,av); return 0; }
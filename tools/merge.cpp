@@ -60,7 +60,7 @@ namespace mini {
       std::cout << MINI_COLOR_LIGHT_BLUE
                 << "loading mini file from " << inFileName 
                 << MINI_COLOR_DEFAULT << std::endl;
-      Scene::SP scene = Scene::load(inFileName);
+      Scene::SP scene = Scene::loadPaged(inFileName);
       for (auto inst : scene->instances) {
         if (mergeStatic && inst->xfm == affine3f()) {
           if (out->instances.empty()) {
@@ -71,6 +71,7 @@ namespace mini {
           if (out->instances.size() == 1 && out->instances[0]->xfm == affine3f()) {
             for (auto mesh : inst->object->meshes)
               out->instances[0]->object->meshes.push_back(mesh);
+            out->instances[0]->object->markDirty();
             continue;
           }
         }
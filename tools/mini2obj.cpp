@@ -15,65 +15,83 @@
 // ======================================================================== //
 
 #include "miniScene/Scene.h"
-#include "miniScene/Serialized.h"
+#include "miniScene/SceneReader.h"
 #include <fstream>
+#include <cstdio>
 
 namespace mini {
 
-  void writeToOBJ(Scene::SP scene,
+  /*! writes the scene in the given reader to an OBJ file, one
+      instance (and, within that, one mesh) at a time - so only the
+      instance table ever has to be in memory */
+  void writeToOBJ(SceneReader &reader,
                   const std::string &outFileName)
   {
-    SerializedScene serialized(scene.get());
-    PRINT(outFileName);
-    std::ofstream obj(outFileName);
-    std::ofstream mtl(outFileName+".mtl");
-    obj << "mtllib " << outFileName << ".mtl" << std::endl;
-
-    std::cout << "#mini2obj: writing " << serialized.materials.size() << " materials" << std::endl;
-    for (int matID=0;matID<serialized.materials.size();matID++) {
-      mtl << "newmaterial mat_" << matID << std::endl;
-      Material::SP mat = serialized.materials[matID];
-      if (mat) {
+    struct Visitor : public SceneVisitor {
+      Visitor(std::ofstream &obj, std::ofstream &mtl) : obj(obj), mtl(mtl) {}
+      
+      void onMaterial(int matID, const Material &mat, int, int) override
+      {
+        mtl << "newmaterial mat_" << matID << std::endl;
         mtl << "kd "
-            << mat->baseColor.x << " "
-            << mat->baseColor.y << " "
-            << mat->baseColor.z << std::endl;
+            << mat.baseColor.x << " "
+            << mat.baseColor.y << " "
+            << mat.baseColor.z << std::endl;
+        mtl << std::endl;
       }
-      mtl << std::endl;
-    }
-
-    std::cout << "writing meshes ...." << std::endl;
-    for (int instID=0;instID<scene->instances.size();instID++) {
-      Instance::SP inst = scene->instances[instID];
-        
-      if (!inst) continue;
-
-      Object::SP object = inst->object;
-      // it's valid to have null instnaces and null objects, but not
-      // to have non-nullinstances of null objects...
-      assert(object);
-      for (int meshID=0;meshID<object->meshes.size();meshID++) {
-        Mesh::SP mesh = object->meshes[meshID];
-        if (!mesh)
-          continue;
-        std::cout << "\r# writing inst " << instID << "/" << scene->instances.size()
-                  << " mesh " << meshID << "/" << object->meshes.size()
+      void onObject(int objectID, const std::vector<int> &meshIDs) override
+      { numMeshes = meshIDs.size(); meshNo = 0; }
+      void onMesh(int objectID, int meshID, const Mesh &mesh, int materialID) override
+      {
+        std::cout << "\r# writing inst " << instID << "/" << instances.size()
+                  << " mesh " << meshNo << "/" << numMeshes
                   << "         " << std::flush;
-        // PRINT(mesh->indices.size());
-        obj << "o inst_" << instID << "_mesh_" << meshID << std::endl;
-        obj << "usemtl mat_" << serialized.getID(mesh->material) << std::endl;
+        obj << "o inst_" << instID << "_mesh_" << meshNo++ << std::endl;
+        obj << "usemtl mat_" << materialID << std::endl;
 
-        for (int i=0;i<mesh->vertices.size();i++) {
-          vec3f v = xfmPoint(inst->xfm,mesh->vertices[i]);
+        const affine3f &xfm = instances[instID].first;
+        for (int i=0;i<mesh.vertices.size();i++) {
+          vec3f v = xfmPoint(xfm,mesh.vertices[i]);
           obj << "v " << v.x << " " << v.y << " " << v.z << std::endl;
         }
 
-        int v0 = (int)mesh->vertices.size();
-        for (int i=0;i<mesh->indices.size();i++) {
-          vec3i v = mesh->indices[i];
+        int v0 = (int)mesh.vertices.size();
+        for (int i=0;i<mesh.indices.size();i++) {
+          vec3i v = mesh.indices[i];
           obj << "f " << (v.x-v0) << " " << (v.y-v0) << " " << (v.z-v0) << std::endl;
         }
       }
+      void onInstance(int instanceID, const affine3f &xfm, int objectID) override
+      {
+        // it's valid to have null instnaces and null objects, but not
+        // to have non-nullinstances of null objects...
+        assert(objectID >= 0);
+        instances.push_back({xfm,objectID});
+      }
+      
+      std::ofstream &obj;
+      std::ofstream &mtl;
+      std::vector<std::pair<affine3f,int>> instances;
+      int    instID    = 0;
+      size_t numMeshes = 0;
+      int    meshNo    = 0;
+    };
+    
+    PRINT(outFileName);
+    std::ofstream obj(outFileName);
+    std::ofstream mtl(outFileName+".mtl");
+    obj << "mtllib " << outFileName << ".mtl" << std::endl;
+
+    Visitor visitor(obj,mtl);
+    std::cout << "#mini2obj: writing " << reader.numMaterials() << " materials" << std::endl;
+    reader.visitMaterials(visitor);
+
+    std::cout << "writing meshes ...." << std::endl;
+    reader.visitInstances(visitor);
+    for (auto &inst : visitor.instances) {
+      if (inst.second >= 0)
+        reader.visitObject(inst.second,visitor);
+      visitor.instID++;
     }
     std::cout << std::endl;
     obj.close();
@@ -96,18 +114,27 @@ namespace mini {
     if (inFileName.empty())
       throw std::runtime_error("no input file specified");
 
-    std::cout << MINI_COLOR_LIGHT_BLUE
-              << "loading mini file from " << inFileName 
-              << MINI_COLOR_DEFAULT << std::endl;
-    Scene::SP scene = Scene::load(inFileName);
-    std::cout << MINI_COLOR_LIGHT_GREEN
-              << "#mini2obj: scene loaded."
-              << MINI_COLOR_DEFAULT << std::endl;
+    std::string tmpFileName = "";
+    if (!SceneReader::canRead(inFileName)) {
+      /* older files can't be streamed through, so first convert
+         them to the current format */
+      tmpFileName = outFileName+".tmp.mini";
+      std::cout << MINI_COLOR_LIGHT_BLUE
+                << "upgrading mini file " << inFileName << " to " << tmpFileName
+                << MINI_COLOR_DEFAULT << std::endl;
+      Scene::load(inFileName)->save(tmpFileName);
+      inFileName = tmpFileName;
+    }
 
     std::cout << MINI_COLOR_LIGHT_BLUE
               << "saving to " << outFileName 
               << MINI_COLOR_DEFAULT << std::endl;
-    writeToOBJ(scene,outFileName);
+    {
+      SceneReader reader(inFileName);
+      writeToOBJ(reader,outFileName);
+    }
+    if (!tmpFileName.empty())
+      std::remove(tmpFileName.c_str());
     std::cout << MINI_COLOR_LIGHT_GREEN
               << "#mini2obj: OBJ and MTL files saved."
               << MINI_COLOR_DEFAULT << std::endl;
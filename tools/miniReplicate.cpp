@@ -32,6 +32,7 @@ namespace mini {
       float scale = 1.f;
       int numReplications = 20;
       bool flat = true;
+      SaveOptions saveOptions;
       for (int i=1;i<ac;i++) {
         std::string arg = av[i];
         if (arg == "-o") {
@@ -40,6 +41,8 @@ namespace mini {
           flat = true;
         } else if (arg == "--not-flat") {
           flat = false;
+        } else if (arg == "--dedup-meshes") {
+          saveOptions.dedupMeshes = true;
         } else if (arg == "-n") {
           numReplications = std::atoi(av[++i]);
         } else if (arg == "-s") {
@@ -124,7 +127,11 @@ namespace mini {
                 << "saving to " << outFileName 
                 << MINI_COLOR_DEFAULT << std::endl;
       // writeToOBJ(out,outFileName);
-      out->save(outFileName);
+      SaveStats stats = out->saveParallel(outFileName,saveOptions);
+      if (saveOptions.dedupMeshes)
+        std::cout << "folded " << stats.numDedupedMeshes
+                  << " duplicate meshes, saving "
+                  << stats.numDedupedMeshBytes << " bytes" << std::endl;
       std::cout << MINI_COLOR_LIGHT_GREEN
                 << "#brixReplicate: replicated model written...."
                 << MINI_COLOR_DEFAULT << std::endl;
@@ -76,7 +76,7 @@ namespace mini {
     std::cout << MINI_COLOR_LIGHT_BLUE
               << "loading mini file from " << inFileName 
               << MINI_COLOR_DEFAULT << std::endl;
-    Scene::SP scene = Scene::load(inFileName);
+    Scene::SP scene = Scene::loadPaged(inFileName);
     std::cout << MINI_COLOR_LIGHT_GREEN
               << "#miniSeparateRootMeshes: scene loaded."
               << MINI_COLOR_DEFAULT << std::endl;
@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2018-2022 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/*! checks the checksums of all records of one or more ".mini" files,
+    without loading them; exits with 0 if all files are intact, 1 if
+    any record of any file is corrupt (or a file cannot be read at
+    all), and 2 if a file is too old to have checksums */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Checksum.h"
+#include <chrono>
+#include <iomanip>
+
+namespace mini {
+
+  typedef std::chrono::steady_clock Clock;
+
+  void usage(const std::string &msg)
+  {
+    if (!msg.empty()) std::cerr << std::endl << "***Error***: " << msg << std::endl << std::endl;
+    std::cout << "Usage: ./miniVerify file1.mini [file2.mini ...] [--mapped|--stream]" << std::endl;
+    std::cout << "Checks the checksums of all records of the given files" << std::endl;
+    std::cout << " --mapped : memory-map the files" << std::endl;
+    std::cout << " --stream : read with std::ifstream (default: bulk reads)" << std::endl;
+    exit(msg.empty() ? 0 : 1);
+  }
+
+  int miniVerify(int ac, char **av)
+  {
+    std::vector<std::string> fileNames;
+    LoadOptions options;
+    options.readMethod = LoadOptions::READ_BULK;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "--mapped")
+        options.mapped = true;
+      else if (arg == "--stream")
+        options.readMethod = LoadOptions::READ_STREAM;
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        fileNames.push_back(arg);
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (fileNames.empty())
+      usage("no input file specified");
+    if (!crc32cIsHardwareAccelerated())
+      std::cout << MINI_COLOR_YELLOW
+                << "warning: no CRC instructions on this CPU, checking will be slow"
+                << MINI_COLOR_DEFAULT << std::endl;
+    
+    int exitCode = 0;
+    for (auto fileName : fileNames) {
+      Clock::time_point t0 = Clock::now();
+      VerifyResult result;
+      try {
+        result = Scene::verify(fileName,options);
+      } catch (const std::exception &e) {
+        std::cout << MINI_COLOR_RED << fileName << ": UNREADABLE (" << e.what() << ")"
+                  << MINI_COLOR_DEFAULT << std::endl;
+        exitCode = 1;
+        continue;
+      }
+      const double seconds
+        = std::chrono::duration<double>(Clock::now()-t0).count();
+      
+      if (!result.hasChecksums) {
+        std::cout << MINI_COLOR_YELLOW << fileName
+                  << ": no checksums (written by an older version)"
+                  << MINI_COLOR_DEFAULT << std::endl;
+        exitCode = std::max(exitCode,2);
+        continue;
+      }
+      if (!result.corruptRecords.empty()) {
+        std::cout << MINI_COLOR_RED << fileName << ": CORRUPT - "
+                  << result.corruptRecords.size() << " of " << result.numRecords
+                  << " records do not match their checksums:" << MINI_COLOR_DEFAULT << std::endl;
+        for (auto &name : result.corruptRecords)
+          std::cout << "  " << name << std::endl;
+        exitCode = 1;
+        continue;
+      }
+      std::cout << MINI_COLOR_GREEN << fileName << ": OK" << MINI_COLOR_DEFAULT
+                << " (" << result.numRecords << " records, "
+                << prettyNumber(result.numBytes) << "B, "
+                << std::fixed << std::setprecision(2)
+                << (result.numBytes/seconds*1e-9) << " GB/s)" << std::endl;
+    }
+    return exitCode;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ return mini::miniVerify(ac,av); }
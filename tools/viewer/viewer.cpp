@@ -15,7 +15,7 @@
 // ======================================================================== //
 
 #include "samples/common/owlViewer/OWLViewer.h"
-#include "miniScene/Scene.h"
+#include "miniScene/FlatScene.h"
 #include <owl/owl.h>
 #include "deviceCode.h"
 
@@ -49,8 +49,8 @@ namespace miniViewer {
   {
     typedef owl::viewer::OWLViewer inherited;
     
-    Viewer(Scene::SP scene)
-      : scene(scene)
+    Viewer(FlatScene::SP flat)
+      : flat(flat)
     {
       createContext();
       createModule();
@@ -64,72 +64,74 @@ namespace miniViewer {
       owlBuildSBT(owl);
     }
 
-    OWLGeom createMesh(Mesh::SP mesh)
+    OWLGeom createMesh(size_t meshID)
     {
+      const FlatMesh &mesh = flat->meshes[meshID];
       OWLGeom geom = owlGeomCreate(owl,meshGT);
       OWLBuffer indexBuffer
         = owlDeviceBufferCreate(owl,OWL_INT3,
-                                mesh->indices.size(),
-                                mesh->indices.data());
+                                mesh.numTriangles,
+                                flat->getIndices(meshID));
       OWLBuffer vertexBuffer
         = owlDeviceBufferCreate(owl,OWL_FLOAT3,
-                                mesh->vertices.size(),
-                                mesh->vertices.data());
+                                mesh.numVertices,
+                                flat->getVertices(meshID));
       OWLBuffer normalBuffer
-        = mesh->normals.empty()
+        = mesh.numNormals == 0
         ? 0
         : owlDeviceBufferCreate(owl,OWL_FLOAT3,
-                                mesh->normals.size(),
-                                mesh->normals.data());
+                                mesh.numNormals,
+                                flat->getNormals(meshID));
       OWLBuffer texcoordBuffer
-        = mesh->texcoords.empty()
+        = mesh.numTexcoords == 0
         ? 0
         : owlDeviceBufferCreate(owl,OWL_FLOAT2,
-                                mesh->texcoords.size(),
-                                mesh->texcoords.data());
+                                mesh.numTexcoords,
+                                flat->getTexcoords(meshID));
 
       owlTrianglesSetVertices(geom,vertexBuffer,
-                              mesh->vertices.size(),sizeof(vec3f),0);
+                              mesh.numVertices,sizeof(vec3f),0);
       owlTrianglesSetIndices(geom,indexBuffer,
-                             mesh->indices.size(),sizeof(vec3i),0);
+                             mesh.numTriangles,sizeof(vec3i),0);
       return geom;
     }
 
-    OWLGroup createObject(Object::SP object)
+    OWLGroup createObject(size_t objectID,
+                          const std::vector<OWLGeom> &meshGeoms)
     {
-      OWLGroup group = createdObjects[object];        
-      if (!group) {
-        std::vector<OWLGeom> geoms;
-        for (auto mesh : object->meshes)
-          geoms.push_back(createMesh(mesh));
+      const FlatObject &object = flat->objects[objectID];
+      std::vector<OWLGeom> geoms;
+      for (size_t i=0;i<object.numMeshes;i++)
+        geoms.push_back(meshGeoms[flat->objectMeshes[object.firstMesh+i]]);
         
-        group = owlTrianglesGeomGroupCreate
-          (owl,geoms.size(),geoms.data()
-           ,OPTIX_BUILD_FLAG_ALLOW_RANDOM_VERTEX_ACCESS | OPTIX_BUILD_FLAG_ALLOW_COMPACTION
-           );
-        owlGroupBuildAccel(group);
-        createdObjects[object] = group;
-      }
+      OWLGroup group = owlTrianglesGeomGroupCreate
+        (owl,geoms.size(),geoms.data()
+         ,OPTIX_BUILD_FLAG_ALLOW_RANDOM_VERTEX_ACCESS | OPTIX_BUILD_FLAG_ALLOW_COMPACTION
+         );
+      owlGroupBuildAccel(group);
       return group;
     }
     
     void createWorld()
     {
-      std::vector<OWLGroup> instanceGroups;
-      std::vector<affine3f> instanceXfms;
+      /* meshes shared by several objects get created only once */
+      std::vector<OWLGeom> meshGeoms;
+      for (size_t meshID=0;meshID<flat->meshes.size();meshID++)
+        meshGeoms.push_back(createMesh(meshID));
       
-      for (auto inst : scene->instances) {
-        if (!inst) continue;
-        if (!inst->object) continue;
-        
-        instanceGroups.push_back(createObject(inst->object));
-        instanceXfms.push_back(inst->xfm);
-      }
+      std::vector<OWLGroup> objectGroups;
+      for (size_t objectID=0;objectID<flat->objects.size();objectID++)
+        objectGroups.push_back(createObject(objectID,meshGeoms));
+
+      std::vector<OWLGroup> instanceGroups;
+      for (auto objectID : flat->objectIDs)
+        instanceGroups.push_back(objectGroups[objectID]);
+      /* the flat scene's transforms can be used as they are */
       world = owlInstanceGroupCreate(owl,
                                      instanceGroups.size(),
                                      instanceGroups.data(),
                                      nullptr,
-                                     (float*)instanceXfms.data());
+                                     (const float*)flat->transforms.data());
       owlGroupBuildAccel(world);
     }
 
@@ -240,8 +242,7 @@ namespace miniViewer {
     OWLParams   lp;
     OWLMissProg missProg;
     OWLRayGen   rayGen;
-    std::map<Object::SP,OWLGroup> createdObjects;
-    Scene::SP scene;
+    FlatScene::SP flat;
     vec2i fbSize;
   };
   
@@ -292,11 +293,15 @@ extern "C" int main(int argc, char **argv)
         vec2i(1024);
     }
 
-    Scene::SP scene = Scene::load(inFileName);
+    Scene::SP scene = Scene::loadMapped(inFileName);
+    /* from the bounds stored in the file, so this costs nothing */
+    box3f sceneBounds = scene->getBounds();
+    /* the flat scene has its own copies of all arrays, so the scene
+       (and with it, the mapping of the file) can go right away */
+    FlatScene::SP flat = FlatScene::compile(scene.get());
+    scene = nullptr;
     
-    Viewer viewer(scene);
-    box3f sceneBounds;
-    sceneBounds = scene->getBounds();
+    Viewer viewer(flat);
     viewer.enableFlyMode();
     viewer.enableInspectMode();
 